@@ -0,0 +1,306 @@
+// End-to-end solver benchmark. Solves every puzzle of a corpus a number of times and writes the
+// timings as one JSON document to stdout, so that builds can be compared before and after a
+// change to the solver.
+#include "puzzle.hpp"
+#include "solver.hpp"
+#include "log.hpp"
+#include "example_puzzles.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Larger puzzles, in the "_"-prefixed binary format the web client exports
+
+// Dots, squares, stars and a triangle on a 5x5 grid
+const char* const DOTS_STARS_5X5 =
+    "_AAAAAAsLAAAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAA"
+    "AAQAAAAAAAQAAAAAF/wAA/wMAAQAAAAAAAQAAAAACAAAA/wABAAAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAA"
+    "AAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAABAAAAAAABAAAAAAABAAAAAAABAAAAAAA"
+    "BAAAAAAEAAAAAAQAAAAABAAAAAAEAAQAAAQAAAAABAAAAAAEAAQAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAA"
+    "BAAAAAAABAAAAAAP/////AAEAAAAAAAEAAAAAAAEAAAAAAQAAAAABAAAAAAEAAQAAAQAAAAABAAAAAAEAAAAAAQA"
+    "BAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAQAAAwAAAP8AAQAAAAACAAAA/wABAAAAAAL/////AAEAAAAAAAEAAAA"
+    "AAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAA"
+    "AA/////8AAQAAAAAAAQAAAAAAAQAAAAAAAQAAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAEAAAEAAAAAAQAAAAA"
+    "BAAAAAQEAAAAAAQABAAQBAAAAAAEAAAAAAAAAAA0=";
+
+// Squares, stars, triangles and dots on a 5x5 grid
+const char* const TRIANGLES_5X5 =
+    "_AAAAAAsLAAAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQABAAIBAAAAAAEAAAA"
+    "AAQAAAAACAAAA/wABAAAAAAABAAAAAAX/AAD/AgABAAAAAAABAAAAAAMAAAD/AAEAAAAAAQAAAAABAAAAAAEAAAA"
+    "AAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAAEAAAAAAAEAAAAAAAEAAAAABf8"
+    "AAP8CAAEAAAAAAAEAAAAAAQAAAAABAAAAAAEAAAABAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAA"
+    "BAAAAAAEAAAAAAAEAAAAAAAEAAQAAAAEAAAAAAAEAAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAE"
+    "AAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAAEAAAAABf8AAP8DAAEAAAAAAv////8AAQAAAAAAAQA"
+    "AAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQA"
+    "AAAAAAQAAAAAAAQAAAAAD/////wABAAAAAAABAAAAAAABAAEAAAEAAQAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAA"
+    "AAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAAAAAAADQ==";
+
+// Dots, a square and a star on a 4x4 pillar
+const char* const PILLAR_4X4 =
+    "_AAAAAAgJAAAAABABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAEBAAAAAAP////"
+    "/AAEAAAAAAAEAAAAAAAEAAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAEAAAEAAAAAAQAAAAABAAAAAAE"
+    "AAAAAAQAAAAAAAQAAAAAC/////wABAAAAAAABAAAAAAABAAAAAAEAAAAAAQABAAABAAAAAAEAAAAAAQAAAAABAAA"
+    "AAAEAAAAAAQAAAAABAAAAAAEAAAAAAAEAAAAAAAEAAAAAAAEAAQAAAAEAAAAAAQAAAAgBAAAAAAEAAAAAAQAAAAA"
+    "BAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAAAAQAAAAAAAQAAAAAAAQAAAAAAAQAAAAAAAAAADQ==";
+
+// A 6x6 symmetry puzzle with no solution, so the whole tree is searched
+const char* const SYMMETRY_6X6 =
+    "_AAAAAA0NAAAAAA4BAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAA"
+    "CAQAAAAABAAAAAAEAAAAAAAEAAAAAAwAAAP8AAQAAAAAAAQAAAAAAAQAAAAAAAQAAAAAF/wAA/wEAAQADAAABAAA"
+    "AAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAA"
+    "AAAEAAAAAAAEAAAAAAAEAAAAAAgAAAP8AAQAAAAAAAQAAAAAAAQAAAAABAAAAAAEAAwAAAQAAAAABAAAAAAEAAAA"
+    "AAQAAAAABAAAAAAEAAAAAAQAAAAABAAEAAAEAAAAAAQAAAAABAAAAAAEAAAAAAAEAAAAABf8AAP8BAAEAAAAAAAE"
+    "AAAAABf8AAP8DAAEAAAAAA/////8AAQAAAAAAAQAAAAABAAAAAQEAAAAAAQAAAAABAAMAAAEAAgAAAQAAAAABAAA"
+    "AAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAQEAAAAAAv////8AAQAAAAAAAQAAAAACAAAA/wABAAAAAAX"
+    "/AAD/AwABAAAAAAIAAAD/AAEAAAAAAwAAAP8AAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAA"
+    "AAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAAEAAAAAAAEAAAAAAAEAAAAABf8AAP8DAAEAAAA"
+    "ABf8AAP8BAAEAAAAAAv////8AAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAQAAAQA"
+    "AAAABAAAAAAEAAAAAAQACAAABAAAAAAEAAAAAAAEAAAAAAAEAAAAAAAEAAAAAAwAAAP8AAQAAAAAAAQAAAAAF/wA"
+    "A/wMAAQAAAAABAAAAAAEAAAAAAQAAAAQBAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQA"
+    "AAAABAAAAAAAAAAAN";
+
+// Squares, triangles, dots and a negation on a 4x4 grid
+const char* const NEGATION_4X4 =
+    "_AAAAAAkJAAAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAIAAAD"
+    "/AAEAAAAAAAEAAAAAAAEAAAAABf8AAP8CAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAA"
+    "BAAAAAAEAAAAAAQAAAAAC/////wABAAAAAAX/AAD/AwABAAAAAAX/AAD/AgABAAAAAAT/////AAEAAAAAAQAAAAA"
+    "BAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAEBAAAAAAEAAAAAAQABAAACAAAA/wABAAAAAAIAAAD/AAEAAAA"
+    "AAgAAAP8AAQAAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAEAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAA"
+    "AAAABAAAAAAABAAAAAAABAAAAAAABAAAAAAEAAAAEAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAA"
+    "BAAAAAAAAAAAN";
+
+// Four negations with squares, a star, a triangle and dots on a 4x4 grid
+const char* const FOUR_NEGATIONS_4X4 =
+    "_AAAAAAkJAAAAAAABAAAACAEAAQAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAT////"
+    "/AAEAAAAAAAEAAAAABP////8AAQAAAAAE/////wABAAAAAAEAAAAAAQAAAAABAAEAAAEAAAAAAQABAAABAAAAAAE"
+    "AAAAAAQAAAAABAAEAAAEAAAAAAgAAAP8AAQAAAAAAAQAAAAAE/////wABAAAAAAABAAAAAAEAAAAAAQAAAAABAAA"
+    "AAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAv////8AAQAAAAAAAQAAAAACAAAA/wABAAAAAAP"
+    "/AAD/AAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAAAAQAAAAA"
+    "AAQAAAAAAAQAAAAAF/wAA/wMAAQAAAAABAAAAAQEAAAAAAQAAAAABAAAAAAEAAAAAAQAAAAABAAAAAAEAAAAAAQA"
+    "BAAAAAAAADQ==";
+
+struct BenchPuzzle {
+    std::string name;
+    std::string data;  // JSON or "_"-prefixed binary
+};
+
+struct BenchOptions {
+    int warmup = 2;    // Untimed solves before the timed ones
+    int reps = 10;     // Timed solves of each puzzle
+    int threads = 1;
+    int moveOrder = ORDER_FIXED;
+    int pruning = PRUNE_NONE;
+    int transpositionBits = 0;
+    bool builtIn = true;
+    std::string filter;                // Only run puzzles whose name contains this
+    std::vector<std::string> corpora;  // Extra JSONL files, one puzzle per line
+};
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] [puzzles.jsonl ...]\n"
+              << "  Solves each puzzle of the built-in corpus, and of any JSONL files given, and writes\n"
+              << "  median and 95th percentile solve times, nodes per second and solutions per second\n"
+              << "  as JSON to stdout. Lines hold either JSON or \"_\"-prefixed binary puzzles.\n"
+              << "Options:\n"
+              << "  --warmup N          Untimed solves of each puzzle first (default: 2)\n"
+              << "  --reps N            Timed solves of each puzzle (default: 10)\n"
+              << "  --threads N         Worker threads per solve (default: 1)\n"
+              << "  --order NAME        Move ordering: fixed (default), end, dots\n"
+              << "  --prune             Enable every pruning heuristic\n"
+              << "  --tt-bits N         Size of the transposition table, 2^N with N at most 30\n"
+              << "                      (default: off)\n"
+              << "  --filter TEXT       Only run puzzles whose name contains TEXT\n"
+              << "  --no-builtin        Skip the built-in corpus\n";
+}
+
+std::vector<BenchPuzzle> builtInCorpus() {
+    return {
+        {"EXAMPLE_PUZZLE", EXAMPLE_PUZZLE},
+        {"EXAMPLE_PUZZLE1", EXAMPLE_PUZZLE1},
+        {"EXAMPLE_PUZZLE2", EXAMPLE_PUZZLE2},
+        {"EXAMPLE_PUZZLE3", EXAMPLE_PUZZLE3},
+        {"EXAMPLE_PUZZLE4", EXAMPLE_PUZZLE4},
+        {"EXAMPLE_PUZZLE5", EXAMPLE_PUZZLE5},
+        {"POLY_PUZZLE", POLY_PUZZLE},
+        {"POLY_PUZZLE2", POLY_PUZZLE2},
+        {"POLY_CANCEL_PUZZLE", POLY_CANCEL_PUZZLE},
+        {"POLY_CANCEL_PUZZLE2", POLY_CANCEL_PUZZLE2},
+        {"POLY_INVALID_PUZZLE", POLY_INVALID_PUZZLE},
+        {"DOTS_STARS_5X5", DOTS_STARS_5X5},
+        {"TRIANGLES_5X5", TRIANGLES_5X5},
+        {"PILLAR_4X4", PILLAR_4X4},
+        {"SYMMETRY_6X6", SYMMETRY_6X6},
+        {"NEGATION_4X4", NEGATION_4X4},
+        {"FOUR_NEGATIONS_4X4", FOUR_NEGATIONS_4X4},
+    };
+}
+
+// Puzzles from a JSONL file are named after the file and line
+void readCorpus(const std::string& path, std::vector<BenchPuzzle>& corpus) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    size_t lineNumber = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        corpus.push_back({path + ":" + std::to_string(lineNumber), line});
+    }
+}
+
+// Value below which the given fraction of the sorted samples lie, interpolating between the two
+// nearest samples
+double percentile(const std::vector<double>& sorted, double fraction) {
+    double rank = fraction * (sorted.size() - 1);
+    size_t below = static_cast<size_t>(rank);
+    size_t above = std::min(below + 1, sorted.size() - 1);
+    return sorted[below] + (sorted[above] - sorted[below]) * (rank - below);
+}
+
+json benchPuzzle(const BenchPuzzle& bench, const BenchOptions& options) {
+    json result;
+    result["name"] = bench.name;
+    try {
+        std::vector<double> micros;
+        size_t solutions = 0;
+        uint64_t nodes = 0;
+        for (int rep = -options.warmup; rep < options.reps; rep++) {
+            // Only the solve is timed, not parsing the puzzle
+            size_t first = bench.data.find_first_not_of(" \t\r");
+            auto puzzle = first != std::string::npos && bench.data[first] == '_'
+                ? Puzzle::deserializeBinary(bench.data) : Puzzle::deserialize(bench.data);
+            Solver solver(std::move(puzzle));
+            solver.setThreads(options.threads);
+            solver.setMoveOrder(options.moveOrder);
+            solver.setPruning(options.pruning);
+            solver.setTranspositionBits(options.transpositionBits);
+            
+            auto solveStart = std::chrono::steady_clock::now();
+            solutions = solver.solve([](const PathView&) { return true; });
+            auto solveEnd = std::chrono::steady_clock::now();
+            
+            nodes = solver.getStats().nodes;
+            if (rep >= 0) {
+                micros.push_back(std::chrono::duration<double, std::micro>(solveEnd - solveStart).count());
+            }
+        }
+        std::sort(micros.begin(), micros.end());
+        
+        double median = percentile(micros, 0.5);
+        double seconds = median / 1e6;
+        result["solutions"] = solutions;
+        result["nodes"] = nodes;
+        result["medianMicros"] = median;
+        result["p95Micros"] = percentile(micros, 0.95);
+        result["minMicros"] = micros.front();
+        result["maxMicros"] = micros.back();
+        result["nodesPerSecond"] = seconds > 0 ? nodes / seconds : 0.0;
+        result["solutionsPerSecond"] = seconds > 0 ? solutions / seconds : 0.0;
+    } catch (const std::exception& e) {
+        result["error"] = e.what();
+    }
+    return result;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--warmup" && i + 1 < argc) {
+                options.warmup = std::max(0, std::stoi(argv[++i]));
+            } else if (arg == "--reps" && i + 1 < argc) {
+                options.reps = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = std::stoi(argv[++i]);
+            } else if (arg == "--tt-bits" && i + 1 < argc) {
+                options.transpositionBits = std::stoi(argv[++i]);
+                if (options.transpositionBits < 0 || options.transpositionBits > TranspositionTable::MAX_BITS) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            } else if (arg == "--filter" && i + 1 < argc) {
+                options.filter = argv[++i];
+            } else if (arg == "--order" && i + 1 < argc) {
+                std::string name = argv[++i];
+                auto found = std::find(std::begin(MOVE_ORDER_NAMES), std::end(MOVE_ORDER_NAMES), name);
+                if (found == std::end(MOVE_ORDER_NAMES)) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                options.moveOrder = static_cast<int>(found - std::begin(MOVE_ORDER_NAMES));
+            } else if (arg == "--prune") {
+                options.pruning = PRUNE_ALL;
+            } else if (arg == "--no-builtin") {
+                options.builtIn = false;
+            } else if (arg == "--help" || arg == "-h") {
+                printUsage(argv[0]);
+                return 0;
+            } else if (arg[0] != '-') {
+                options.corpora.push_back(arg);
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    std::vector<BenchPuzzle> corpus;
+    if (options.builtIn) {
+        corpus = builtInCorpus();
+    }
+    try {
+        for (const auto& path : options.corpora) {
+            readCorpus(path, corpus);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    json report;
+    report["warmup"] = options.warmup;
+    report["reps"] = options.reps;
+    report["threads"] = options.threads;
+    report["order"] = MOVE_ORDER_NAMES[options.moveOrder];
+    report["pruning"] = options.pruning;
+    report["transpositionBits"] = options.transpositionBits;
+    report["puzzles"] = json::array();
+    
+    auto benchStart = std::chrono::steady_clock::now();
+    double totalMedian = 0;
+    for (const auto& bench : corpus) {
+        if (bench.name.find(options.filter) == std::string::npos) continue;
+        PUZZLE_LOG(LOG_INFO, "Benchmarking " << bench.name);
+        json result = benchPuzzle(bench, options);
+        if (result.contains("medianMicros")) {
+            totalMedian += result["medianMicros"].get<double>();
+        }
+        report["puzzles"].push_back(std::move(result));
+    }
+    report["totalMedianMicros"] = totalMedian;
+    
+    std::cout << report.dump(2) << std::endl;
+    
+    auto benchEnd = std::chrono::steady_clock::now();
+    std::cerr << "Benchmarked " << report["puzzles"].size() << " puzzles in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(benchEnd - benchStart).count() << " ms"
+              << std::endl;
+    return 0;
+}
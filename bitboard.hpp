@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Fixed-width bitset over the (2w+1)x(2h+1) puzzle lattice.
+// Bit i corresponds to the lattice point (i / height, i % height), matching grid[x][y].
+// The width is chosen once at construction, so every operation is a handful of word ops.
+class Bitboard {
+public:
+    Bitboard() = default;
+    explicit Bitboard(int bits) : numBits(bits), words((bits + 63) / 64, 0) {}
+
+    int size() const { return numBits; }
+
+    bool test(int i) const {
+        return (words[i >> 6] >> (i & 63)) & 1;
+    }
+
+    void set(int i) {
+        words[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+
+    void reset(int i) {
+        words[i >> 6] &= ~(uint64_t(1) << (i & 63));
+    }
+
+    void clear() {
+        for (auto& word : words) word = 0;
+    }
+
+    int count() const {
+        int total = 0;
+        for (auto word : words) total += __builtin_popcountll(word);
+        return total;
+    }
+
+    bool any() const {
+        for (auto word : words) {
+            if (word) return true;
+        }
+        return false;
+    }
+
+    // True if every bit set in this board is also set in other
+    bool isSubsetOf(const Bitboard& other) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            if (words[i] & ~other.words[i]) return false;
+        }
+        return true;
+    }
+
+    bool intersects(const Bitboard& other) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            if (words[i] & other.words[i]) return true;
+        }
+        return false;
+    }
+
+    Bitboard& operator|=(const Bitboard& other) {
+        for (size_t i = 0; i < words.size(); i++) words[i] |= other.words[i];
+        return *this;
+    }
+
+    Bitboard& operator&=(const Bitboard& other) {
+        for (size_t i = 0; i < words.size(); i++) words[i] &= other.words[i];
+        return *this;
+    }
+
+    bool operator==(const Bitboard& other) const { return words == other.words; }
+    bool operator!=(const Bitboard& other) const { return words != other.words; }
+
+    // Calls fn(i) for every set bit, in increasing order
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t w = 0; w < words.size(); w++) {
+            uint64_t word = words[w];
+            while (word) {
+                int bit = __builtin_ctzll(word);
+                fn(static_cast<int>(w * 64 + bit));
+                word &= word - 1;
+            }
+        }
+    }
+
+private:
+    int numBits = 0;
+    std::vector<uint64_t> words;
+};
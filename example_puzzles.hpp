@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string>
+
+// Small hand-written puzzles in the JSON format read by Puzzle::deserialize, used by the demo in
+// main.cpp and as the base of the benchmark corpus in bench.cpp.
+
+inline const std::string EXAMPLE_PUZZLE = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
+        [{"line": 0}, {"type": "star", "color": 2}, {"line": 0}, {"type": "star", "color": 2}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "square", "color": 1}, {"line": 0}, {"type": "square", "color": 1}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}],
+        [{"line": 0}, {"type": "triangle", "color": 3, "count": 1}, {"line": 0}, {"type": "nega"}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}]
+    ],
+    "pillar": false
+})";
+
+inline const std::string EXAMPLE_PUZZLE1 = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
+        [{"line": 0}, null,{"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0},null, {"line": 0}, {"type": "nega"}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
+    ],
+    "pillar": false
+})";
+
+inline const std::string EXAMPLE_PUZZLE2 = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
+        [{"line": 0}, null,{"line": 0, "dot": 1}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0},null, {"line": 0}, null, {"line": 0}],
+        [{"line": 0, "dot": 1}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}, {"end": "bottom"}]
+    ],
+    "pillar": false
+})";
+
+inline const std::string EXAMPLE_PUZZLE3 = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
+        [{"line": 0}, {"type": "nega"},{"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0},{"type": "nega"}, {"line": 0}, {"type": "nega"}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
+    ],
+    "pillar": false
+})";
+
+inline const std::string EXAMPLE_PUZZLE4 = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
+        [{"line": 0}, {"type": "star", "color": 2}, {"line": 0}, {"type": "star", "color": 2}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "square", "color": 1}, {"line": 0}, {"type": "square", "color": 1}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}],
+        [{"line": 0}, {"type": "triangle", "color": 3, "count": 1}, {"line": 0}, {"type": "poly", "polyshape": 3}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}]
+    ],
+    "pillar": false
+})";
+
+inline const std::string EXAMPLE_PUZZLE5 = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
+        [{"line": 0}, {"type": "star", "color": 2}, {"line": 0}, {"type": "star", "color": 2}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "square", "color": 1}, {"line": 0}, {"type": "square", "color": 1}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}],
+        [{"line": 0}, {"type": "nega"}, {"line": 0}, {"type": "poly", "polyshape": 19}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}]
+    ],
+    "pillar": false
+})";
+
+// Example puzzle with polyominos
+inline const std::string POLY_PUZZLE = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "poly", "polyshape": 3}, {"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "poly", "polyshape": 3}, {"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
+    ],
+    "pillar": false
+})";
+
+inline const std::string POLY_PUZZLE2 = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "poly", "polyshape": 3, "rotate": 0}, {"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, null, {"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
+    ],
+    "pillar": false
+})";
+
+// Example puzzle with polyominos that should perfectly cancel out
+inline const std::string POLY_CANCEL_PUZZLE = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "poly", "polyshape": 51}, {"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "ylop", "polyshape": 1}, {"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
+    ],
+    "pillar": false
+})";
+
+inline const std::string POLY_CANCEL_PUZZLE2 = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "poly", "polyshape": 19}, {"line": 0}, {"type": "ylop", "polyshape": 1}, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, null, {"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
+    ],
+    "pillar": false
+})";
+
+// Example with polys and ylops that don't match - this should be invalid
+inline const std::string POLY_INVALID_PUZZLE = R"({
+    "grid": [
+        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "poly", "polyshape": 3}, {"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
+        [{"line": 0}, {"type": "ylop", "polyshape": 1}, {"line": 0}, null, {"line": 0}],
+        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
+    ],
+    "pillar": false
+})";
@@ -0,0 +1,31 @@
+#include "log.hpp"
+#include <atomic>
+#include <iostream>
+
+namespace {
+std::atomic<int> runtimeLevel{LOG_WARN};
+
+const char* const LEVEL_NAMES[] = {"", "error", "warn", "info", "debug", "trace"};
+}
+
+void setLogLevel(int level) {
+    runtimeLevel.store(level, std::memory_order_relaxed);
+}
+
+int getLogLevel() {
+    return runtimeLevel.load(std::memory_order_relaxed);
+}
+
+bool logEnabled(int level) {
+    return level <= runtimeLevel.load(std::memory_order_relaxed);
+}
+
+void logWrite(int level, const std::string& message) {
+    // Built up front and written in one call, so lines from different threads don't interleave
+    std::string line = "[";
+    line += LEVEL_NAMES[level < LOG_ERROR || level > LOG_TRACE ? LOG_NONE : level];
+    line += "] ";
+    line += message;
+    line += '\n';
+    std::clog.write(line.data(), static_cast<std::streamsize>(line.size()));
+}
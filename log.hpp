@@ -0,0 +1,38 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+
+// Log levels, from most to least important
+constexpr int LOG_NONE = 0;
+constexpr int LOG_ERROR = 1;
+constexpr int LOG_WARN = 2;
+constexpr int LOG_INFO = 3;
+constexpr int LOG_DEBUG = 4;
+constexpr int LOG_TRACE = 5;  // Per-cell and per-node detail
+
+// Messages above this level are compiled out entirely (their arguments are never evaluated).
+// Set with -DPUZZLE_LOG_LEVEL=<0..5>, or the PUZZLE_LOG_LEVEL CMake cache variable.
+#ifndef PUZZLE_LOG_LEVEL
+#define PUZZLE_LOG_LEVEL 4
+#endif
+
+// Runtime threshold for the levels that were compiled in. Defaults to LOG_WARN.
+void setLogLevel(int level);
+int getLogLevel();
+bool logEnabled(int level);
+
+// Writes one finished line to stderr without flushing
+void logWrite(int level, const std::string& message);
+
+// PUZZLE_LOG(LOG_DEBUG, "Found start at " << x << "," << y);
+#define PUZZLE_LOG(level, message)                                  \
+    do {                                                            \
+        if constexpr ((level) <= PUZZLE_LOG_LEVEL) {                \
+            if (logEnabled(level)) {                                \
+                std::ostringstream logStream;                       \
+                logStream << message;                               \
+                logWrite(level, logStream.str());                   \
+            }                                                       \
+        }                                                           \
+    } while (0)
@@ -1,141 +1,194 @@
 #include "puzzle.hpp"
 #include "solver.hpp"
 #include "polyomino.hpp"
+#include "thread_pool.hpp"
+#include "log.hpp"
+#include "example_puzzles.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
 
-const std::string EXAMPLE_PUZZLE = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
-        [{"line": 0}, {"type": "star", "color": 2}, {"line": 0}, {"type": "star", "color": 2}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "square", "color": 1}, {"line": 0}, {"type": "square", "color": 1}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}],
-        [{"line": 0}, {"type": "triangle", "color": 3, "count": 1}, {"line": 0}, {"type": "nega"}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}]
-    ],
-    "pillar": false
-})";
+using json = nlohmann::json;
 
-const std::string EXAMPLE_PUZZLE1 = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
-        [{"line": 0}, null,{"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0},null, {"line": 0}, {"type": "nega"}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
-    ],
-    "pillar": false
-})";
+namespace {
 
-const std::string EXAMPLE_PUZZLE2 = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
-        [{"line": 0}, null,{"line": 0, "dot": 1}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0},null, {"line": 0}, null, {"line": 0}],
-        [{"line": 0, "dot": 1}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}, {"end": "bottom"}]
-    ],
-    "pillar": false
-})";
+struct BatchOptions {
+    std::string input = "-";   // "-" reads from stdin
+    int threads = 0;           // 0 uses every core
+    int maxSolutions = 0;      // 0 finds every solution
+    bool paths = true;         // Include the solution paths in each result
+    int moveOrder = ORDER_FIXED;
+    int pruning = PRUNE_NONE;
+    int timeLimitMillis = 0;   // 0 lets every puzzle run to completion
+    int transpositionBits = 0;
+};
 
-const std::string EXAMPLE_PUZZLE3 = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
-        [{"line": 0}, {"type": "nega"},{"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0},{"type": "nega"}, {"line": 0}, {"type": "nega"}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
-    ],
-    "pillar": false
-})";
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] [puzzles.jsonl | -]\n"
+              << "  Solves one puzzle per input line and writes one JSON result per line to stdout,\n"
+              << "  in the order puzzles finish. Lines hold either the JSON read by Puzzle::deserialize\n"
+              << "  or the \"_\"-prefixed binary format of engine/serializer.js.\n"
+              << "  With no arguments, solves the built-in demo puzzle.\n"
+              << "Options:\n"
+              << "  --threads N         Worker threads (default: all cores)\n"
+              << "  --max-solutions N   Stop each puzzle after N solutions (default: all)\n"
+              << "  --no-paths          Only report solution counts\n"
+              << "  --order NAME        Move ordering: fixed (default), end (toward the nearest end),\n"
+              << "                      dots (toward the nearest uncovered dot)\n"
+              << "  --prune             Skip moves into unreachable points and dead ends, and abandon\n"
+              << "                      paths that can no longer reach an end or an uncovered dot\n"
+              << "  --tt-bits N         Skip search states already known to be dead, remembering\n"
+              << "                      up to 2^N of them per puzzle, N at most 30 (default: off)\n"
+              << "  --time-limit MS     Give up on each puzzle after MS milliseconds, reporting the\n"
+              << "                      solutions found so far and the estimated progress\n"
+              << "  --log-level N       Diagnostics on stderr: 0 none, 1 error, 2 warn (default),\n"
+              << "                      3 info, 4 debug, 5 trace (if compiled in)\n";
+}
 
-const std::string EXAMPLE_PUZZLE4 = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
-        [{"line": 0}, {"type": "star", "color": 2}, {"line": 0}, {"type": "star", "color": 2}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "square", "color": 1}, {"line": 0}, {"type": "square", "color": 1}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}],
-        [{"line": 0}, {"type": "triangle", "color": 3, "count": 1}, {"line": 0}, {"type": "poly", "polyshape": 3}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}]
-    ],
-    "pillar": false
-})";
-
-const std::string EXAMPLE_PUZZLE5 = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0, "dot": 1}, {"line": 0}],
-        [{"line": 0}, {"type": "star", "color": 2}, {"line": 0}, {"type": "star", "color": 2}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "square", "color": 1}, {"line": 0}, {"type": "square", "color": 1}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}],
-        [{"line": 0}, {"type": "nega"}, {"line": 0}, {"type": "poly", "polyshape": 19}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}]
-    ],
-    "pillar": false
-})";
-
-// Example puzzle with polyominos
-const std::string POLY_PUZZLE = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "poly", "polyshape": 3}, {"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "poly", "polyshape": 3}, {"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
-    ],
-    "pillar": false
-})";
-
-const std::string POLY_PUZZLE2 = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "poly", "polyshape": 3, "rotate": 0}, {"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, null, {"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
-    ],
-    "pillar": false
-})";
-
-// Example puzzle with polyominos that should perfectly cancel out
-const std::string POLY_CANCEL_PUZZLE = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "poly", "polyshape": 51}, {"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "ylop", "polyshape": 1}, {"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
-    ],
-    "pillar": false
-})";
+// Solves a single input line and formats its result line
+std::string solveLine(const std::string& line, size_t lineNumber, const BatchOptions& options) {
+    json result;
+    result["line"] = lineNumber;
+    try {
+        auto parseStart = std::chrono::steady_clock::now();
+        // Like deserializePuzzle in engine/serializer.js, accept both JSON and "_"-prefixed binary
+        size_t first = line.find_first_not_of(" \t\r");
+        auto puzzle = first != std::string::npos && line[first] == '_'
+            ? Puzzle::deserializeBinary(line) : Puzzle::deserialize(line);
+        auto parseEnd = std::chrono::steady_clock::now();
+        
+        // Puzzles are already spread over the pool, so each one is solved on a single thread
+        Solver solver(std::move(puzzle));
+        solver.setThreads(1);
+        solver.setMaxSolutions(options.maxSolutions);
+        solver.setMoveOrder(options.moveOrder);
+        solver.setPruning(options.pruning);
+        solver.setTranspositionBits(options.transpositionBits);
+        // Paths are written straight into the result as they are found, rather than kept as Paths
+        json paths = json::array();
+        size_t solutionCount = 0;
+        auto addPath = [&](const PathView& solution) {
+            if (options.paths) {
+                json positions = json::array();
+                for (size_t i = 0; i < solution.size; i++) {
+                    positions.push_back({solution.positions[i].first, solution.positions[i].second});
+                }
+                paths.push_back(std::move(positions));
+            }
+            solutionCount++;
+            return true;
+        };
+        
+        if (options.timeLimitMillis > 0) {
+            solver.beginSolve();
+            bool finished = solver.resumeSolve(0, std::chrono::milliseconds(options.timeLimitMillis));
+            // Kept solutions are packed, and only decoded here if the paths are wanted
+            for (const PackedPath& solution : solver.takeSolutions()) {
+                if (options.paths) {
+                    json positions = json::array();
+                    solution.forEach([&](int x, int y, int) { positions.push_back({x, y}); });
+                    paths.push_back(std::move(positions));
+                }
+                solutionCount++;
+            }
+            result["complete"] = finished;
+            result["progress"] = solver.getProgress();
+        } else {
+            solver.solve(addPath);
+        }
+        auto solveEnd = std::chrono::steady_clock::now();
+        
+        result["solutions"] = solutionCount;
+        if (options.paths) {
+            result["paths"] = std::move(paths);
+        }
+        result["parseMicros"] = std::chrono::duration_cast<std::chrono::microseconds>(parseEnd - parseStart).count();
+        result["solveMicros"] = std::chrono::duration_cast<std::chrono::microseconds>(solveEnd - parseEnd).count();
+        
+        const SolverStats& stats = solver.getStats();
+        result["stats"] = {
+            {"order", MOVE_ORDER_NAMES[stats.moveOrder]},
+            {"pruning", stats.pruning},
+            {"nodes", stats.nodes},
+            {"prunedMoves", stats.prunedMoves},
+            {"validations", stats.validations},
+            {"reachabilityChecks", stats.reachabilityChecks},
+            {"prunedBranches", stats.prunedBranches},
+            {"regionCacheHits", stats.regionCacheHits},
+            {"regionCacheMisses", stats.regionCacheMisses},
+            {"polyCacheHits", stats.polyCacheHits},
+            {"polyCacheMisses", stats.polyCacheMisses},
+            {"transpositionHits", stats.transpositionHits},
+            {"deadStates", stats.deadStates},
+        };
+    } catch (const std::exception& e) {
+        result["error"] = e.what();
+    }
+    return result.dump();
+}
 
-const std::string POLY_CANCEL_PUZZLE2 = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "poly", "polyshape": 19}, {"line": 0}, {"type": "ylop", "polyshape": 1}, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, null, {"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
-    ],
-    "pillar": false
-})";
+int runBatch(const BatchOptions& options) {
+    std::ifstream file;
+    if (options.input != "-") {
+        file.open(options.input);
+        if (!file) {
+            std::cerr << "Error: cannot open " << options.input << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = options.input == "-" ? std::cin : file;
+    
+    ThreadPool pool(options.threads);
+    
+    // Only a few puzzles per worker are read ahead, so memory stays flat however long the input is
+    const size_t maxInFlight = 4 * static_cast<size_t>(pool.size());
+    size_t inFlight = 0;
+    std::mutex outputMutex;
+    std::condition_variable slotFree;
+    
+    auto batchStart = std::chrono::steady_clock::now();
+    size_t lineNumber = 0;
+    size_t puzzleCount = 0;
+    std::string line;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        puzzleCount++;
+        
+        {
+            std::unique_lock<std::mutex> lock(outputMutex);
+            slotFree.wait(lock, [&] { return inFlight < maxInFlight; });
+            inFlight++;
+        }
+        
+        pool.submit([&, lineNumber, line = std::move(line)] {
+            auto result = solveLine(line, lineNumber, options);
+            {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cout << result << '\n' << std::flush;
+                inFlight--;
+            }
+            slotFree.notify_one();
+        });
+        line = std::string();
+    }
+    pool.wait();
+    
+    auto batchEnd = std::chrono::steady_clock::now();
+    auto batchDuration = std::chrono::duration_cast<std::chrono::milliseconds>(batchEnd - batchStart);
+    std::cerr << "Solved " << puzzleCount << " puzzles in " << batchDuration.count() << " ms on "
+              << pool.size() << " threads" << std::endl;
+    return 0;
+}
 
-// Example with polys and ylops that don't match - this should be invalid
-const std::string POLY_INVALID_PUZZLE = R"({
-    "grid": [
-        [{"start": true, "line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "poly", "polyshape": 3}, {"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}],
-        [{"line": 0}, {"type": "ylop", "polyshape": 1}, {"line": 0}, null, {"line": 0}],
-        [{"line": 0}, {"line": 0}, {"line": 0}, {"line": 0}, {"end": "bottom"}]
-    ],
-    "pillar": false
-})";
+}
 
-int main() {
+int runDemo() {
     try {
         // Demo polyomino puzzle solving
         std::cout << "=== Polyomino Puzzle Solving ===" << std::endl;
@@ -159,8 +212,8 @@ int main() {
                 Cell* cell = puzzle->getCell(x, y);
                 if (!cell) continue;
                 
-                if ((cell->type == "poly" || cell->type == "ylop") && cell->polyshape > 0) {
-                    std::cout << "- " << cell->type << " at (" << x << "," << y << ") with shape " 
+                if ((cell->type == TYPE_POLY || cell->type == TYPE_YLOP) && cell->polyshape > 0) {
+                    std::cout << "- " << cellTypeToString(cell->type) << " at (" << x << "," << y << ") with shape " 
                              << cell->polyshape << " (size: " << getPolySize(cell->polyshape) << ")" << std::endl;
                     
                     // Print the polyomino shape
@@ -175,24 +228,18 @@ int main() {
             }
         }
         
-        // Start timing puzzle solving
+        // Solutions are printed as they are found, so they are not held in memory
         auto solveStart = std::chrono::high_resolution_clock::now();
         Solver solver(std::move(puzzle));
         solver.setMaxSolutions(100000);
-        auto solutions = solver.solve();
-        auto solveEnd = std::chrono::high_resolution_clock::now();
-        auto solveDuration = std::chrono::duration_cast<std::chrono::microseconds>(solveEnd - solveStart);
-        
-        std::cout << "Puzzle solved in " << solveDuration.count() << " microseconds" << std::endl;
-        std::cout << "Found " << solutions.size() << " solutions" << std::endl;
-        
-        for (size_t i = 0; i < solutions.size(); i++) {
-            std::cout << "Solution " << (i + 1) << ":" << std::endl;
+        size_t printed = 0;
+        size_t solutionCount = solver.solve([&](const PathView& solution) {
+            std::cout << "Solution " << ++printed << ":" << std::endl;
             
             // Print coordinates
-            for (const auto& pos : solutions[i].positions) {
-                std::cout << "  (" << pos.first << "," << pos.second << ")";
-                if (pos != solutions[i].positions.back()) {
+            for (size_t i = 0; i < solution.size; i++) {
+                std::cout << "  (" << solution.positions[i].first << "," << solution.positions[i].second << ")";
+                if (i + 1 < solution.size) {
                     std::cout << " ->";
                 }
             }
@@ -200,12 +247,18 @@ int main() {
             
             // Draw solution on board
             auto solutionPuzzle = Puzzle::deserialize(puzzleString);
-            for (const auto& pos : solutions[i].positions) {
-                solutionPuzzle->updateCell(pos.first, pos.second, "line", LINE_BLACK);
+            for (size_t i = 0; i < solution.size; i++) {
+                solutionPuzzle->updateCell(solution.positions[i].first, solution.positions[i].second, "line", LINE_BLACK);
             }
             solutionPuzzle->printBoard();
             std::cout << std::endl;
-        }
+            return true;
+        });
+        auto solveEnd = std::chrono::high_resolution_clock::now();
+        auto solveDuration = std::chrono::duration_cast<std::chrono::microseconds>(solveEnd - solveStart);
+        
+        std::cout << "Puzzle solved in " << solveDuration.count() << " microseconds" << std::endl;
+        std::cout << "Found " << solutionCount << " solutions" << std::endl;
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -213,4 +266,61 @@ int main() {
     }
     
     return 0;
-} 
\ No newline at end of file
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 1) {
+        // The demo shows the solver's progress messages too
+        setLogLevel(LOG_DEBUG);
+        return runDemo();
+    }
+    
+    BatchOptions options;
+    bool haveInput = false;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc) {
+                options.threads = std::stoi(argv[++i]);
+            } else if (arg == "--max-solutions" && i + 1 < argc) {
+                options.maxSolutions = std::stoi(argv[++i]);
+            } else if (arg == "--tt-bits" && i + 1 < argc) {
+                options.transpositionBits = std::stoi(argv[++i]);
+                if (options.transpositionBits < 0 || options.transpositionBits > TranspositionTable::MAX_BITS) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            } else if (arg == "--time-limit" && i + 1 < argc) {
+                options.timeLimitMillis = std::stoi(argv[++i]);
+            } else if (arg == "--log-level" && i + 1 < argc) {
+                setLogLevel(std::stoi(argv[++i]));
+            } else if (arg == "--order" && i + 1 < argc) {
+                std::string name = argv[++i];
+                auto found = std::find(std::begin(MOVE_ORDER_NAMES), std::end(MOVE_ORDER_NAMES), name);
+                if (found == std::end(MOVE_ORDER_NAMES)) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                options.moveOrder = static_cast<int>(found - std::begin(MOVE_ORDER_NAMES));
+            } else if (arg == "--prune") {
+                options.pruning = PRUNE_ALL;
+            } else if (arg == "--no-paths") {
+                options.paths = false;
+            } else if (arg == "--help" || arg == "-h") {
+                printUsage(argv[0]);
+                return 0;
+            } else if (!haveInput && (arg == "-" || arg[0] != '-')) {
+                options.input = arg;
+                haveInput = true;
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    return runBatch(options);
+}
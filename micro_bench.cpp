@@ -0,0 +1,326 @@
+// Micro-benchmarks of the validation and polyomino kernels, on generated grids of several sizes
+// and symbol densities. Each kernel is run on its own, so a regression in one of them shows up
+// without the noise of a whole solve. Results go to stdout as one JSON document, with the time
+// and the number of heap allocations per call.
+#include "puzzle.hpp"
+#include "polyomino.hpp"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+// Every allocation made through operator new, in any thread
+std::atomic<uint64_t> allocations{0};
+
+// Every operator new and delete below goes through this pair. Kept out of line, so that GCC
+// does not see a new paired with free and warn about mismatched deallocation.
+[[gnu::noinline]] void* allocate(size_t size, size_t alignment) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    size = size ? size : 1;
+    if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+    // aligned_alloc wants a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+[[gnu::noinline]] void release(void* p) noexcept {
+    std::free(p);
+}
+
+void* allocateOrThrow(size_t size, size_t alignment) {
+    if (void* p = allocate(size, alignment)) return p;
+    throw std::bad_alloc();
+}
+}
+
+void* operator new(size_t size) { return allocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return allocateOrThrow(size, 0); }
+void* operator new(size_t size, std::align_val_t al) { return allocateOrThrow(size, size_t(al)); }
+void* operator new[](size_t size, std::align_val_t al) { return allocateOrThrow(size, size_t(al)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return allocate(size, size_t(al));
+}
+void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return allocate(size, size_t(al));
+}
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p); }
+
+namespace {
+
+// Results are folded into this so that the compiler cannot drop the calls being timed
+volatile uint64_t sink = 0;
+
+struct MicroOptions {
+    int minTimeMillis = 100;  // Least time spent timing each benchmark
+    std::string filter;       // Only run benchmarks whose name contains this
+};
+
+// The shapes fuzzed against engine/polyominos.js: monomino up to tetrominos, lines and corners
+const uint32_t SHAPES[] = {1, 3, 17, 19, 51, 7, 273, 785, 4369, 35, 23};
+
+const int GRID_SIZES[] = {3, 5, 8};
+const double DENSITIES[] = {0.2, 0.5, 0.8};
+
+// Runs fn in doubling batches until minTimeMillis have passed, after one untimed call
+template <typename Fn>
+json measure(const std::string& name, json params, const MicroOptions& options, Fn&& fn) {
+    fn();
+
+    uint64_t ops = 0;
+    uint64_t batch = 1;
+    uint64_t allocationsBefore = allocations.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds elapsed{0};
+    while (elapsed < std::chrono::milliseconds(options.minTimeMillis)) {
+        for (uint64_t i = 0; i < batch; i++) {
+            fn();
+        }
+        ops += batch;
+        batch *= 2;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    uint64_t allocated = allocations.load(std::memory_order_relaxed) - allocationsBefore;
+
+    json result;
+    result["name"] = name;
+    result["params"] = std::move(params);
+    result["ops"] = ops;
+    result["nsPerOp"] = static_cast<double>(elapsed.count()) / ops;
+    result["allocsPerOp"] = static_cast<double>(allocated) / ops;
+    return result;
+}
+
+// A width x height puzzle where each content cell holds a symbol with probability density, and a
+// line drawn by a random self-avoiding walk from the top left corner. The line ends wherever the
+// walk gets stuck, so regions are closed off as they would be partway through a solve.
+std::unique_ptr<Puzzle> generatePuzzle(int size, double density, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> chance(0, 1);
+    auto puzzle = std::make_unique<Puzzle>(size, size);
+
+    for (int x = 1; x < puzzle->getActualWidth(); x += 2) {
+        for (int y = 1; y < puzzle->getActualHeight(); y += 2) {
+            if (chance(random) >= density) continue;
+            Cell& cell = puzzle->at(puzzle->index(x, y));
+            double kind = chance(random);
+            if (kind < 0.3) {
+                cell.type = TYPE_SQUARE;
+                cell.color = 1 + random() % 2;
+            } else if (kind < 0.5) {
+                cell.type = TYPE_STAR;
+                cell.color = 1 + random() % 2;
+            } else if (kind < 0.7) {
+                cell.type = TYPE_TRIANGLE;
+                cell.color = 3;
+                cell.count = 1 + random() % 3;
+            } else if (kind < 0.95) {
+                cell.type = random() % 4 == 0 ? TYPE_YLOP : TYPE_POLY;
+                cell.color = 4;
+                cell.polyshape = SHAPES[random() % std::size(SHAPES)] | (random() % 2 ? ROTATION_BIT : 0);
+            } else {
+                cell.type = TYPE_NEGA;
+                cell.nega = NEGA_WHITE;
+            }
+        }
+    }
+
+    // Walk over the lattice points, covering the edge between each step
+    int x = 0;
+    int y = 0;
+    puzzle->at(puzzle->index(x, y)).line = LINE_BLACK;
+    const int steps[4][2] = {{-2, 0}, {2, 0}, {0, -2}, {0, 2}};
+    while (true) {
+        int options[4];
+        int count = 0;
+        for (int d = 0; d < 4; d++) {
+            int nx = x + steps[d][0];
+            int ny = y + steps[d][1];
+            if (nx < 0 || ny < 0 || nx >= puzzle->getActualWidth() || ny >= puzzle->getActualHeight()) continue;
+            if (puzzle->at(puzzle->index(nx, ny)).line != LINE_NONE) continue;
+            options[count++] = d;
+        }
+        if (count == 0) break;
+        int d = options[random() % count];
+        puzzle->at(puzzle->index(x + steps[d][0] / 2, y + steps[d][1] / 2)).line = LINE_BLACK;
+        x += steps[d][0];
+        y += steps[d][1];
+        puzzle->at(puzzle->index(x, y)).line = LINE_BLACK;
+    }
+    return puzzle;
+}
+
+// Every lattice point of a region covering the first cellsWide x cellsHigh content cells, with a
+// placement grid that asks for each of those content cells to be covered once
+struct PlacementInput {
+    std::vector<std::pair<int, int>> region;
+    std::vector<std::pair<int, int>> positions;  // Content cells of the region
+    std::vector<std::vector<int>> grid;
+};
+
+PlacementInput generatePlacement(int cellsWide, int cellsHigh) {
+    PlacementInput input;
+    input.grid.assign(2 * cellsWide + 1, std::vector<int>(2 * cellsHigh + 1, 0));
+    for (int x = 1; x < 2 * cellsWide; x++) {
+        for (int y = 1; y < 2 * cellsHigh; y++) {
+            input.region.push_back({x, y});
+            if (x % 2 == 1 && y % 2 == 1) {
+                input.positions.push_back({x, y});
+                input.grid[x][y] = -1;
+            }
+        }
+    }
+    return input;
+}
+
+// Random shapes, drawn until their sizes add up to at least density of the region's area
+std::vector<uint32_t> generateShapes(int area, double density, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::vector<uint32_t> shapes;
+    int covered = 0;
+    while (covered < area * density) {
+        uint32_t shape = SHAPES[random() % std::size(SHAPES)] | ROTATION_BIT;
+        shapes.push_back(shape);
+        covered += getPolySize(shape);
+    }
+    return shapes;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  Times each validation and polyomino kernel on generated inputs and writes ns/op\n"
+              << "  and allocations/op as JSON to stdout.\n"
+              << "Options:\n"
+              << "  --min-time MS       Least time spent timing each benchmark (default: 100)\n"
+              << "  --filter TEXT       Only run benchmarks whose name contains TEXT\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    MicroOptions options;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--min-time" && i + 1 < argc) {
+                options.minTimeMillis = std::stoi(argv[++i]);
+            } else if (arg == "--filter" && i + 1 < argc) {
+                options.filter = argv[++i];
+            } else if (arg == "--help" || arg == "-h") {
+                printUsage(argv[0]);
+                return 0;
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    json benchmarks = json::array();
+    auto run = [&](const std::string& name, json params, auto&& fn) {
+        if (name.find(options.filter) == std::string::npos) return;
+        benchmarks.push_back(measure(name, std::move(params), options, fn));
+    };
+
+    // Grid kernels, on the same generated puzzles
+    for (int size : GRID_SIZES) {
+        for (double density : DENSITIES) {
+            json params = {{"size", size}, {"density", density}};
+            auto puzzle = generatePuzzle(size, density, 1000 * size + static_cast<uint32_t>(density * 100));
+
+            // The region cache would answer every call after the first
+            puzzle->getRegionCache().setCapacity(0);
+            run("validate", params, [&] { sink = sink + puzzle->validate(); });
+            puzzle->getRegionCache().setCapacity(RegionCache::DEFAULT_CAPACITY);
+            run("validate_cached", params, [&] { sink = sink + puzzle->validate(); });
+
+            run("getRegions", params, [&] { sink = sink + puzzle->getRegions().size(); });
+
+            // The flood fill behind getRegion, over the largest region
+            std::pair<int, int> seed;
+            size_t largest = 0;
+            for (const auto& region : puzzle->getRegions()) {
+                if (region.size() > largest) {
+                    largest = region.size();
+                    seed = region.front();
+                }
+            }
+            run("floodFill", params, [&] {
+                sink = sink + puzzle->getRegionCells(seed.first, seed.second).size();
+            });
+        }
+    }
+
+    // Shape kernels, over every test shape with and without rotation
+    for (uint32_t shape : SHAPES) {
+        for (bool rotated : {false, true}) {
+            uint32_t polyshape = shape | (rotated ? ROTATION_BIT : 0);
+            json params = {{"polyshape", shape}, {"rotate", rotated}};
+            run("getRotations", params, [&] { sink = sink + getRotations(polyshape).size(); });
+            run("polyominoFromPolyshape", params, [&] {
+                sink = sink + polyominoFromPolyshape(polyshape, false, true).size();
+            });
+        }
+    }
+
+    // Placement kernels, on rectangular regions
+    for (int size : GRID_SIZES) {
+        PlacementInput input = generatePlacement(size, size);
+        for (uint32_t shape : SHAPES) {
+            // Place and lift the shape again at the middle of the region, so the grid is unchanged
+            PolyOffsets cells = polyshapeInfo(shape).rotations[0].precise;
+            int x = 2 * (size / 2) + 1;
+            int y = 2 * (size / 2) + 1;
+            json params = {{"size", size}, {"polyshape", shape}};
+            run("tryPlacePolyshape", params, [&] {
+                if (tryPlacePolyshape(cells, x, y, input.grid, 1, input.region)) {
+                    tryPlacePolyshape(cells, x, y, input.grid, -1, input.region);
+                    sink = sink + 1;
+                }
+            });
+        }
+
+        Puzzle puzzle(size, size);
+        std::vector<std::vector<int>> grid = input.grid;
+        for (double density : DENSITIES) {
+            std::vector<uint32_t> shapes = generateShapes(size * size, density, size);
+            json params = {{"size", size}, {"density", density}, {"shapes", shapes.size()}};
+            run("placeShapesRecursively", params, [&] {
+                // Placements are left on the grid, so it is reset first (into the same storage)
+                grid = input.grid;
+                sink = sink + puzzle.placeShapesRecursively(input.positions, grid, shapes, input.region);
+            });
+        }
+    }
+
+    json report;
+    report["minTimeMillis"] = options.minTimeMillis;
+    report["benchmarks"] = std::move(benchmarks);
+    std::cout << report.dump(2) << std::endl;
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "negation_resolver.hpp"
+#include "puzzle.hpp"
+#include <algorithm>
+
+void NegationResolver::clear() {
+    classes.clear();
+    lastInvalid = -1;
+}
+
+void NegationResolver::addSymbol(uint8_t type, uint8_t color, uint32_t polyshape, bool invalid) {
+    for (size_t c = 0; c < classes.size(); c++) {
+        SymbolClass& symbol = classes[c];
+        if (symbol.type == type && symbol.color == color && symbol.polyshape == polyshape &&
+            symbol.invalid == invalid) {
+            symbol.count++;
+            if (invalid) lastInvalid = static_cast<int>(c);
+            return;
+        }
+    }
+    classes.push_back({type, color, polyshape, 1, invalid, 0});
+    if (invalid) lastInvalid = static_cast<int>(classes.size()) - 1;
+}
+
+bool NegationResolver::resolve(int negations, bool negationsCancel, const PolyFit& fit) {
+    this->negations = negations;
+    this->negationsCancel = negationsCancel;
+    this->fit = &fit;
+
+    order.clear();
+    for (size_t c = 0; c < classes.size(); c++) {
+        classes[c].cancelled = 0;
+        if (classes[c].invalid && classes[c].type == TYPE_SQUARE) order.push_back(c);
+    }
+    squareClasses = order.size();
+    for (size_t c = 0; c < classes.size(); c++) {
+        if (classes[c].invalid && classes[c].type != TYPE_SQUARE) order.push_back(c);
+    }
+    colorCounts.resize(256);
+    fits.clear();
+
+    bool valid = search(0, 0);
+    this->fit = nullptr;
+    return valid;
+}
+
+// Chooses how many symbols of each invalid class to cancel, in order
+bool NegationResolver::search(size_t position, int cancelled) {
+    if (position == squareClasses && !squaresAgree()) {
+        return false;
+    }
+
+    if (position == order.size()) {
+        // regionCheckNegations2 gives every negation a symbol until it has used up the last
+        // invalid one, and only then lets the rest cancel each other
+        bool paired = negationsCancel && cancelled < negations && (negations - cancelled) % 2 == 0 &&
+                      (lastInvalid == -1 || classes[lastInvalid].cancelled > 0);
+        return (cancelled == negations || paired) && holds();
+    }
+
+    SymbolClass& symbol = classes[order[position]];
+    int most = std::min(symbol.count, negations - cancelled);
+    for (int count = 0; count <= most; count++) {
+        symbol.cancelled = count;
+        if (search(position + 1, cancelled + count)) {
+            symbol.cancelled = 0;
+            return true;
+        }
+    }
+    symbol.cancelled = 0;
+    return false;
+}
+
+// Squares that are left must all have the same color
+bool NegationResolver::squaresAgree() const {
+    int color = -1;
+    for (const SymbolClass& symbol : classes) {
+        if (symbol.type != TYPE_SQUARE || symbol.cancelled == symbol.count) continue;
+        if (color != -1 && symbol.color != color) return false;
+        color = symbol.color;
+    }
+    return true;
+}
+
+// Whether the symbols left after the current choice break no rule. Squares were checked when
+// the search left them behind.
+bool NegationResolver::holds() {
+    // Each star needs exactly one other symbol of its color
+    for (const SymbolClass& symbol : classes) {
+        if (symbol.color != 0) colorCounts[symbol.color] += symbol.count - symbol.cancelled;
+    }
+    bool starsPaired = true;
+    for (const SymbolClass& symbol : classes) {
+        if (symbol.type == TYPE_STAR && symbol.count > symbol.cancelled && colorCounts[symbol.color] != 2) {
+            starsPaired = false;
+        }
+    }
+    for (const SymbolClass& symbol : classes) {
+        colorCounts[symbol.color] = 0;
+    }
+
+    return starsPaired && polysFit();
+}
+
+bool NegationResolver::polysFit() {
+    // Polyominos are only invalid when they could not tile the region, and then cancelling
+    // some of them is the only way they might
+    bool invalid = false;
+    bool cancelled = false;
+    for (const SymbolClass& symbol : classes) {
+        if (symbol.type != TYPE_POLY && symbol.type != TYPE_YLOP) continue;
+        invalid |= symbol.invalid;
+        cancelled |= symbol.cancelled > 0;
+    }
+    if (!invalid) return true;
+    if (!cancelled) return false;
+
+    key.clear();
+    polys.clear();
+    ylops.clear();
+    for (const SymbolClass& symbol : classes) {
+        if (symbol.type != TYPE_POLY && symbol.type != TYPE_YLOP) continue;
+        key.push_back(symbol.cancelled);
+        if (symbol.polyshape == 0) continue;
+        auto& shapes = symbol.type == TYPE_POLY ? polys : ylops;
+        shapes.insert(shapes.end(), symbol.count - symbol.cancelled, symbol.polyshape);
+    }
+
+    auto known = fits.find(key);
+    if (known != fits.end()) return known->second;
+    bool fitted = (polys.empty() && ylops.empty()) || (*fit)(polys, ylops);
+    fits.emplace(key, fitted);
+    return fitted;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Decides whether the negations in a region can cancel its invalid symbols, trying the same
+// cancellations as regionCheckNegations2 in engine/validate.js.
+// Symbols with the same type, color and shape are interchangeable, so they are grouped into
+// classes and the search only chooses how many of each class to cancel. Five red squares and a
+// blue one with a single negation are 2 choices rather than 6, and the gap grows quickly with
+// more negations.
+class NegationResolver {
+public:
+    // Whether the given polyominos and onimoylops tile the region being checked
+    using PolyFit = std::function<bool(const std::vector<uint32_t>& polys, const std::vector<uint32_t>& ylops)>;
+
+    void clear();
+
+    // Adds a symbol that is left once every uncovered dot, broken triangle and lone star has
+    // taken a negation of its own. Any symbol with a color counts towards the stars' pairs.
+    // invalid marks the symbols regionCheck lists as invalid, which have to be added in its
+    // order: squares, then stars, then polyominos and onimoylops.
+    void addSymbol(uint8_t type, uint8_t color, uint32_t polyshape, bool invalid);
+
+    // True if cancelling some of the invalid symbols with the given number of negations leaves
+    // the region valid. With negationsCancel (NEGATIONS_CANCEL_NEGATIONS), negations left over
+    // once the last invalid symbol has been cancelled may cancel each other in pairs.
+    bool resolve(int negations, bool negationsCancel, const PolyFit& fit);
+
+private:
+    struct SymbolClass {
+        uint8_t type;
+        uint8_t color;
+        uint32_t polyshape;
+        int count;
+        bool invalid;    // Whether negations may cancel symbols of this class
+        int cancelled;   // How many the current choice cancels
+    };
+
+    bool search(size_t position, int cancelled);
+    bool squaresAgree() const;
+    bool holds();
+    bool polysFit();
+
+    std::vector<SymbolClass> classes;
+    std::vector<size_t> order;  // Invalid classes, squares first so that clashing colors prune early
+    size_t squareClasses = 0;   // How many classes at the front of order are squares
+    int lastInvalid = -1;       // Class of the last invalid symbol added
+
+    // State of the current resolve()
+    int negations = 0;
+    bool negationsCancel = false;
+    const PolyFit* fit = nullptr;
+    std::vector<int> colorCounts;
+    std::map<std::vector<int>, bool> fits;  // Cancelled polyominos per class -> whether the rest fit
+    std::vector<int> key;
+    std::vector<uint32_t> polys;
+    std::vector<uint32_t> ylops;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "puzzle.hpp"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+// A path stored as its start point and 2 bits per step (PATH_LEFT..PATH_BOTTOM less one),
+// 32 steps to a word. Positions are decoded on demand by walking the steps from the start.
+// wrapWidth is the lattice width of pillar puzzles, whose paths wrap around the sides, and 0
+// otherwise.
+class PackedPath {
+public:
+    PackedPath() = default;
+    PackedPath(int startX, int startY, int wrapWidth = 0)
+        : x0(startX), y0(startY), wrap(wrapWidth) {}
+
+    int startX() const { return x0; }
+    int startY() const { return y0; }
+
+    // Number of positions, counting the start
+    size_t size() const { return steps + 1; }
+
+    void push(int direction) {
+        if ((steps & 31) == 0) words.push_back(0);
+        words.back() |= uint64_t(direction - PATH_LEFT) << ((steps & 31) * 2);
+        steps++;
+    }
+
+    void pop() {
+        steps--;
+        words[steps >> 5] &= ~(uint64_t(3) << ((steps & 31) * 2));
+        if ((steps & 31) == 0) words.pop_back();
+    }
+
+    // Direction taken to reach position i, PATH_NONE for the start
+    int direction(size_t i) const {
+        if (i == 0) return PATH_NONE;
+        size_t step = i - 1;
+        return PATH_LEFT + static_cast<int>((words[step >> 5] >> ((step & 31) * 2)) & 3);
+    }
+
+    // Calls fn(x, y, direction) for every position in order, as Path would hold them
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        int x = x0;
+        int y = y0;
+        fn(x, y, PATH_NONE);
+        for (size_t i = 1; i <= steps; i++) {
+            int dir = direction(i);
+            if (dir == PATH_LEFT) x--;
+            else if (dir == PATH_RIGHT) x++;
+            else if (dir == PATH_TOP) y--;
+            else y++;
+            if (wrap > 0) x = (x + wrap) % wrap;
+            fn(x, y, dir);
+        }
+    }
+
+    std::vector<std::pair<int, int>> positions() const {
+        std::vector<std::pair<int, int>> result;
+        result.reserve(size());
+        forEach([&](int x, int y, int) { result.push_back({x, y}); });
+        return result;
+    }
+
+    std::vector<int> directions() const {
+        std::vector<int> result;
+        result.reserve(size());
+        for (size_t i = 0; i < size(); i++) result.push_back(direction(i));
+        return result;
+    }
+
+    bool operator==(const PackedPath& other) const {
+        return x0 == other.x0 && y0 == other.y0 && steps == other.steps && words == other.words;
+    }
+    bool operator!=(const PackedPath& other) const { return !(*this == other); }
+
+private:
+    int x0 = 0;
+    int y0 = 0;
+    int wrap = 0;
+    uint32_t steps = 0;
+    std::vector<uint64_t> words;
+};
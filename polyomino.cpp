@@ -1,17 +1,9 @@
 #include "polyomino.hpp"
+#include "puzzle.hpp"
 #include <algorithm>
 #include <limits>
-
-// Count the number of cells in a polyshape
-int getPolySize(uint32_t polyshape) {
-    int size = 0;
-    for (int x = 0; x < 4; x++) {
-        for (int y = 0; y < 4; y++) {
-            if (isSet(polyshape, x, y)) size++;
-        }
-    }
-    return size;
-}
+#include <atomic>
+#include <mutex>
 
 // Get all rotations of a polyshape
 std::vector<uint32_t> getRotations(uint32_t polyshape) {
@@ -19,18 +11,11 @@ std::vector<uint32_t> getRotations(uint32_t polyshape) {
         return {polyshape}; // If not marked as rotatable, return only the original shape
     }
 
+    // All 4 possible 90-degree rotations: original, 90°, 180° and 270° clockwise
     std::vector<uint32_t> rotations(4, 0);
-    
-    // Generate all 4 possible 90-degree rotations
-    for (int x = 0; x < 4; x++) {
-        for (int y = 0; y < 4; y++) {
-            if (isSet(polyshape, x, y)) {
-                rotations[0] ^= mask(x, y);           // Original
-                rotations[1] ^= mask(y, 3-x);         // 90° clockwise
-                rotations[2] ^= mask(3-x, 3-y);       // 180°
-                rotations[3] ^= mask(3-y, x);         // 270° clockwise
-            }
-        }
+    rotations[0] = polyshape & ~ROTATION_BIT;
+    for (int i = 1; i < 4; i++) {
+        rotations[i] = rotateClockwise(rotations[i - 1]);
     }
 
     return rotations;
@@ -94,6 +79,91 @@ std::vector<std::pair<int, int>> polyominoFromPolyshape(uint32_t polyshape, bool
     return polyomino;
 }
 
+namespace {
+
+// One slot per 16-bit shape, with and without the rotation bit
+constexpr int POLYSHAPE_TABLE_SIZE = 1 << 17;
+
+std::atomic<const PolyshapeInfo*> polyshapeTable[POLYSHAPE_TABLE_SIZE];
+std::mutex polyshapeTableMutex;
+
+int polyshapeSlot(uint32_t polyshape) {
+    return static_cast<int>(polyshape & 0xFFFF) | (isRotated(polyshape) ? 1 << 16 : 0);
+}
+
+const PolyshapeInfo* buildPolyshapeInfo(uint32_t polyshape) {
+    auto info = new PolyshapeInfo();
+    info->size = getPolySize(polyshape);
+    
+    // Offsets are appended to one buffer and only turned into pointers once it stops growing
+    struct Ranges { size_t cells, precise, ylop, last; };
+    Ranges ranges[4];
+    auto append = [&](const std::vector<std::pair<int, int>>& cells) {
+        info->offsets.insert(info->offsets.end(), cells.begin(), cells.end());
+    };
+    
+    for (auto rotation : getRotations(polyshape)) {
+        rotation &= ~ROTATION_BIT;
+        bool repeated = false;
+        for (int i = 0; i < info->rotationCount; i++) {
+            if (info->rotations[i].polyshape == rotation) repeated = true;
+        }
+        // Symmetric shapes repeat rotations, which would only repeat the same placements
+        if (repeated) continue;
+        
+        auto& entry = info->rotations[info->rotationCount];
+        entry.polyshape = rotation;
+        int minX = 4, minY = 4, maxX = -1, maxY = -1;
+        for (int x = 0; x < 4; x++) {
+            for (int y = 0; y < 4; y++) {
+                if (!isSet(rotation, x, y)) continue;
+                minX = std::min(minX, x);
+                minY = std::min(minY, y);
+                maxX = std::max(maxX, x);
+                maxY = std::max(maxY, y);
+            }
+        }
+        entry.width = maxX < 0 ? 0 : maxX - minX + 1;
+        entry.height = maxY < 0 ? 0 : maxY - minY + 1;
+        
+        auto& range = ranges[info->rotationCount];
+        range.cells = info->offsets.size();
+        append(polyominoFromPolyshape(rotation, false, false));
+        range.precise = info->offsets.size();
+        append(polyominoFromPolyshape(rotation, false, true));
+        range.ylop = info->offsets.size();
+        append(polyominoFromPolyshape(rotation, true, true));
+        range.last = info->offsets.size();
+        info->rotationCount++;
+    }
+    
+    const auto* base = info->offsets.data();
+    for (int i = 0; i < info->rotationCount; i++) {
+        auto& entry = info->rotations[i];
+        entry.cells = PolyOffsets(base + ranges[i].cells, base + ranges[i].precise);
+        entry.precise = PolyOffsets(base + ranges[i].precise, base + ranges[i].ylop);
+        entry.ylop = PolyOffsets(base + ranges[i].ylop, base + ranges[i].last);
+    }
+    return info;
+}
+
+}
+
+const PolyshapeInfo& polyshapeInfo(uint32_t polyshape) {
+    auto& slot = polyshapeTable[polyshapeSlot(polyshape)];
+    const PolyshapeInfo* info = slot.load(std::memory_order_acquire);
+    if (info) return *info;
+    
+    // Entries are never freed: there are few distinct shapes and they live as long as the process
+    std::lock_guard<std::mutex> lock(polyshapeTableMutex);
+    info = slot.load(std::memory_order_relaxed);
+    if (!info) {
+        info = buildPolyshapeInfo(polyshape);
+        slot.store(info, std::memory_order_release);
+    }
+    return *info;
+}
+
 // Convert a list of cell coordinates to a polyshape
 uint32_t polyshapeFromPolyomino(const std::vector<std::pair<int, int>>& polyomino) {
     // Find the top-left cell
@@ -125,12 +195,9 @@ uint32_t polyshapeFromPolyomino(const std::vector<std::pair<int, int>>& polyomin
 }
 
 // Try to place a polyshape on the grid
-bool tryPlacePolyshape(const std::vector<std::pair<int, int>>& cells, int x, int y, 
+bool tryPlacePolyshape(PolyOffsets cells, int x, int y, 
                       std::vector<std::vector<int>>& grid, int sign, 
                       const std::vector<std::pair<int, int>>& region) {
-    std::vector<std::pair<int, int>> cellsToUpdate;
-    std::vector<int> originalValues;
-    
     // First check if placement is valid
     for (const auto& cell : cells) {
         int newX = x + cell.first;
@@ -155,19 +222,15 @@ bool tryPlacePolyshape(const std::vector<std::pair<int, int>>& cells, int x, int
                 return false;
             }
         }
-        
-        // Content cells (odd coordinates) should be valid for placement
-        if (newX % 2 == 1 && newY % 2 == 1) {
-            // Store cell for update
-            cellsToUpdate.push_back({newX, newY});
-            originalValues.push_back(grid[newX][newY]);
-        }
     }
     
-    // Apply the update
-    for (size_t i = 0; i < cellsToUpdate.size(); i++) {
-        const auto& cell = cellsToUpdate[i];
-        grid[cell.first][cell.second] += sign;
+    // Apply the update to content cells (odd coordinates)
+    for (const auto& cell : cells) {
+        int newX = x + cell.first;
+        int newY = y + cell.second;
+        if (newX % 2 == 1 && newY % 2 == 1) {
+            grid[newX][newY] += sign;
+        }
     }
     
     return true;
@@ -196,9 +259,8 @@ bool placePolys(const std::vector<std::pair<int, int>>& region,
     uint32_t polyShape = polyShapes[polyIndex];
     
     // Try each rotation
-    auto rotations = getRotations(polyShape | ROTATION_BIT);
-    for (auto rotation : rotations) {
-        auto cells = polyominoFromPolyshape(rotation);
+    for (const auto& rotation : polyshapeInfo(polyShape | ROTATION_BIT)) {
+        auto cells = rotation.precise;
         
         // Try to place at the designated position
         int baseX = polyPositions[polyIndex].first;
@@ -217,4 +279,161 @@ bool placePolys(const std::vector<std::pair<int, int>>& region,
     
     // No valid placement found
     return false;
-} 
\ No newline at end of file
+} 
+PolyFitter::PolyFitter(int latticeWidth, int latticeHeight, bool p)
+    : width(latticeWidth), height(latticeHeight), pillar(p) {}
+
+int PolyFitter::cellIndex(int x, int y) const {
+    if (pillar) x = ((x % width) + width) % width;
+    if (x < 0 || y < 0 || x >= width || y >= height) return -1;
+    return x * height + y;
+}
+
+// Adds delta to the demand of every cell of a placement at (x, y). Fails (and leaves the demand
+// unchanged) if any cell is off the grid or would drop below minimum.
+bool PolyFitter::apply(PolyOffsets cells, int x, int y, int delta, int minimum) {
+    for (const auto& [dx, dy] : cells) {
+        int i = cellIndex(x + dx, y + dy);
+        if (i < 0 || need[i] + delta < minimum) return false;
+    }
+    for (const auto& [dx, dy] : cells) {
+        need[cellIndex(x + dx, y + dy)] += delta;
+    }
+    return true;
+}
+
+bool PolyFitter::fit(const std::vector<uint8_t>& region, const std::vector<uint32_t>& polys,
+                     const std::vector<uint32_t>& ylops, uint8_t settingsFlags) {
+    if (polys.empty() && ylops.empty()) return true;
+    
+    int regionSize = 0;
+    for (int x = 1; x < width; x += 2) {
+        for (int y = 1; y < height; y += 2) {
+            if (region[x * height + y]) regionSize++;
+        }
+    }
+    
+    int polyCount = 0;
+    for (auto shape : polys) polyCount += getPolySize(shape);
+    for (auto shape : ylops) polyCount -= getPolySize(shape);
+    if (polyCount > 0 && polyCount != regionSize) return false;
+    if (polyCount < 0) return false;
+    if (polyCount == 0 && (settingsFlags & SETTINGS_FLAG_SZP)) return true;
+    settingsFlags &= SETTINGS_FLAG_SZP | SETTINGS_FLAG_PP;
+    precise = (settingsFlags & SETTINGS_FLAG_PP) != 0;
+    
+    // Identical shapes must produce identical keys, whatever order they were found in
+    sortedPolys.assign(polys.begin(), polys.end());
+    ylopShapes.assign(ylops.begin(), ylops.end());
+    std::sort(sortedPolys.begin(), sortedPolys.end());
+    std::sort(ylopShapes.begin(), ylopShapes.end());
+    
+    // When the sizes cancel out the region plays no part, only the shapes do
+    key.clear();
+    if (polyCount > 0) {
+        key.resize((region.size() + 63) / 64, 0);
+        for (size_t i = 0; i < region.size(); i++) {
+            if (region[i]) key[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+    key.push_back(settingsFlags);
+    key.push_back(sortedPolys.size());
+    for (auto shape : sortedPolys) key.push_back(shape);
+    for (auto shape : ylopShapes) key.push_back(shape);
+    
+    if (const RegionVerdict* cached = cache.find(key)) {
+        return cached->valid;
+    }
+    
+    // In the normal case every content cell and edge of the region needs one poly.
+    // Vertices can never be covered by a precise poly, so they are left out. Polys that are not
+    // precise only cover content cells, and leave the demand on edges alone.
+    need.assign(width * height, 0);
+    if (polyCount > 0) {
+        for (int x = 0; x < width; x++) {
+            for (int y = 0; y < height; y++) {
+                if ((x % 2 == 1 || y % 2 == 1) && region[x * height + y]) need[x * height + y] = 1;
+            }
+        }
+    }
+    
+    polyShapes.clear();
+    polyCounts.clear();
+    for (auto shape : sortedPolys) {
+        if (polyShapes.empty() || polyShapes.back() != shape) {
+            polyShapes.push_back(shape);
+            polyCounts.push_back(0);
+        }
+        polyCounts.back()++;
+    }
+    
+    RegionVerdict verdict;
+    verdict.valid = placeYlops(0, 0);
+    cache.insert(key, verdict);
+    return verdict.valid;
+}
+
+// Places ylops anywhere inside the grid, raising the demand of the cells they cover.
+// Consecutive identical ylops are placed in increasing position order, so each set of placements
+// is only tried once.
+bool PolyFitter::placeYlops(size_t i, int firstPosition) {
+    if (i == ylopShapes.size()) {
+        int polysLeft = 0;
+        for (int count : polyCounts) polysLeft += count;
+        return placePolys(polysLeft);
+    }
+    
+    const auto& info = polyshapeInfo(ylopShapes[i]);
+    int positions = (width / 2) * (height / 2);
+    for (int p = firstPosition; p < positions; p++) {
+        int x = 2 * (p / (height / 2)) + 1;
+        int y = 2 * (p % (height / 2)) + 1;
+        for (const auto& rotation : info) {
+            PolyOffsets cells = precise ? rotation.ylop : rotation.cells;
+            if (!apply(cells, x, y, +1, 0)) continue;
+            bool sameAsNext = i + 1 < ylopShapes.size() && ylopShapes[i + 1] == ylopShapes[i];
+            bool placed = placeYlops(i + 1, sameAsNext ? p : 0);
+            apply(cells, x, y, -1, 0);
+            if (placed) return true;
+        }
+    }
+    return false;
+}
+
+bool PolyFitter::placePolys(int polysLeft) {
+    // Find the top-most row with a content cell that still needs covering
+    int openY = -1;
+    for (int y = 1; y < height && openY == -1; y += 2) {
+        for (int x = 1; x < width; x += 2) {
+            if (need[x * height + y] > 0) {
+                openY = y;
+                break;
+            }
+        }
+    }
+    if (openY == -1) return polysLeft == 0;
+    if (polysLeft == 0) return false;
+    
+    // Some poly's top-left square must cover the first open cell. Pillars have no left edge,
+    // so there any open cell in the top-most row could be that top-left square.
+    for (int x = 1; x < width; x += 2) {
+        if (need[x * height + openY] <= 0) continue;
+        
+        for (size_t s = 0; s < polyShapes.size(); s++) {
+            if (polyCounts[s] == 0) continue;
+            
+            for (const auto& rotation : polyshapeInfo(polyShapes[s])) {
+                PolyOffsets cells = precise ? rotation.precise : rotation.cells;
+                if (!apply(cells, x, openY, -1, 0)) continue;
+                polyCounts[s]--;
+                bool placed = placePolys(polysLeft - 1);
+                polyCounts[s]++;
+                apply(cells, x, openY, +1, 0);
+                if (placed) return true;
+            }
+        }
+        
+        if (!pillar) break;
+    }
+    return false;
+}
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "region_cache.hpp"
 #include <vector>
 #include <utility>
 #include <cstdint>
+#include <cstddef>
 
 // Constants for polyomino types
 constexpr int POLY_NONE = 0;
@@ -13,23 +15,79 @@ constexpr int POLY_YLOP = 2;
 constexpr uint32_t ROTATION_BIT = 1 << 20;
 
 // Functions for bit manipulation of polyshapes
-inline uint32_t mask(int x, int y) {
+constexpr uint32_t mask(int x, int y) {
     return 1 << (x * 4 + y);  // Same bit ordering as JS implementation
 }
 
-inline bool isSet(uint32_t polyshape, int x, int y) {
+constexpr bool isSet(uint32_t polyshape, int x, int y) {
     if (x < 0 || y < 0) return false;
     if (x >= 4 || y >= 4) return false;
     return (polyshape & mask(x, y)) != 0;
 }
 
 // Check if a polyshape has the rotation bit set
-inline bool isRotated(uint32_t polyshape) {
+constexpr bool isRotated(uint32_t polyshape) {
     return (polyshape & ROTATION_BIT) != 0;
 }
 
 // Get the size of a polyshape (number of cells)
-int getPolySize(uint32_t polyshape);
+constexpr int getPolySize(uint32_t polyshape) {
+    return __builtin_popcount(polyshape & 0xFFFF);
+}
+
+// Rotate the 4x4 grid of a polyshape 90 degrees clockwise. The rotation bit is dropped.
+constexpr uint32_t rotateClockwise(uint32_t polyshape) {
+    uint32_t rotated = 0;
+    for (int x = 0; x < 4; x++) {
+        for (int y = 0; y < 4; y++) {
+            if (isSet(polyshape, x, y)) rotated |= mask(y, 3 - x);
+        }
+    }
+    return rotated;
+}
+
+// A borrowed run of cell offsets, relative to the top-left square of a polyomino
+struct PolyOffsets {
+    const std::pair<int, int>* first = nullptr;
+    const std::pair<int, int>* last = nullptr;
+    
+    PolyOffsets() = default;
+    PolyOffsets(const std::pair<int, int>* f, const std::pair<int, int>* l) : first(f), last(l) {}
+    PolyOffsets(const std::vector<std::pair<int, int>>& cells)
+        : first(cells.data()), last(cells.data() + cells.size()) {}
+    
+    const std::pair<int, int>* begin() const { return first; }
+    const std::pair<int, int>* end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+    bool empty() const { return first == last; }
+};
+
+// One distinct orientation of a polyshape
+struct PolyRotation {
+    uint32_t polyshape = 0;  // Rotated shape, without the rotation bit
+    int width = 0;           // Bounding box, in cells
+    int height = 0;
+    PolyOffsets cells;       // Content cells only
+    PolyOffsets precise;     // Content cells and the edges between them (normal polys)
+    PolyOffsets ylop;        // Content cells and every edge around them (ylops)
+};
+
+// Everything placement needs to know about a polyshape, computed once per shape.
+// Shapes without the rotation bit have a single rotation; symmetric shapes only list
+// their distinct rotations.
+struct PolyshapeInfo {
+    int size = 0;
+    int rotationCount = 0;
+    PolyRotation rotations[4];
+    std::vector<std::pair<int, int>> offsets;  // Storage behind every PolyOffsets above
+    
+    const PolyRotation* begin() const { return rotations; }
+    const PolyRotation* end() const { return rotations + rotationCount; }
+};
+
+// Look up the table entry for a polyshape (the rotation bit is significant). Entries are built
+// the first time a shape is seen and are shared between threads; later lookups are a single load.
+const PolyshapeInfo& polyshapeInfo(uint32_t polyshape);
 
 // Get all rotations of a polyshape
 std::vector<uint32_t> getRotations(uint32_t polyshape);
@@ -44,7 +102,7 @@ std::vector<std::pair<int, int>> polyominoFromPolyshape(uint32_t polyshape, bool
 uint32_t polyshapeFromPolyomino(const std::vector<std::pair<int, int>>& polyomino);
 
 // Try to place a polyshape on the grid
-bool tryPlacePolyshape(const std::vector<std::pair<int, int>>& cells, int x, int y, 
+bool tryPlacePolyshape(PolyOffsets cells, int x, int y, 
                        std::vector<std::vector<int>>& grid, int sign, 
                        const std::vector<std::pair<int, int>>& region = {});
 
@@ -53,4 +111,51 @@ bool placePolys(const std::vector<std::pair<int, int>>& region,
                 std::vector<std::vector<int>>& grid,
                 const std::vector<std::pair<int, int>>& polyPositions,
                 const std::vector<uint32_t>& polyShapes,
-                size_t polyIndex = 0); 
\ No newline at end of file
+                size_t polyIndex = 0); 
+// Decides whether the polys in a region exactly tile it, after the ylops in the region have been
+// placed somewhere on the grid to subtract from it. Mirrors polyFit in engine/polyominos.js:
+// every cell inside the region must be covered exactly once more than it is covered by ylops.
+// With precise polyominos, a poly may also only span an edge that is inside the region (or under
+// a ylop).
+//
+// The search is an exact-cover backtracker over a demand grid: the first open cell (in reading
+// order) must be covered by the top-left square of some poly, so only those placements are tried,
+// and identical shapes are never tried twice at the same point. Results are memoized per
+// (region, poly multiset, ylop multiset), since many paths carve out the same regions, in a
+// bounded clock cache like the one holding region verdicts.
+class PolyFitter {
+public:
+    PolyFitter() = default;
+    PolyFitter(int latticeWidth, int latticeHeight, bool pillar);
+
+    // region has one entry per lattice cell (index = x * latticeHeight + y), nonzero when the cell
+    // belongs to the region. Shapes are polyshapes as stored on the cells (with ROTATION_BIT).
+    // settingsFlags are the puzzle's SETTINGS_FLAG_*: PP selects precise polyominos, and SZP
+    // accepts polys and ylops whose sizes cancel out without placing them.
+    bool fit(const std::vector<uint8_t>& region, const std::vector<uint32_t>& polys,
+             const std::vector<uint32_t>& ylops, uint8_t settingsFlags);
+
+    RegionCache& getCache() { return cache; }
+    const RegionCache& getCache() const { return cache; }
+
+private:
+    int width = 0;
+    int height = 0;
+    bool pillar = false;
+    bool precise = true;  // Whether the current fit places PolyRotation::precise and ::ylop offsets
+
+    // Demand left on each lattice cell: how many more times polys must (content cells) or
+    // may (edges) cover it
+    std::vector<int> need;
+    std::vector<uint32_t> polyShapes;   // Distinct poly shapes, with a count of each left to place
+    std::vector<int> polyCounts;
+    std::vector<uint32_t> ylopShapes;   // Sorted, so that identical ylops are adjacent
+    std::vector<uint32_t> sortedPolys;
+    std::vector<uint64_t> key;
+    RegionCache cache;
+
+    int cellIndex(int x, int y) const;
+    bool apply(PolyOffsets cells, int x, int y, int delta, int minimum);
+    bool placeYlops(size_t i, int firstPosition);
+    bool placePolys(int polysLeft);
+};
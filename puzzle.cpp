@@ -2,28 +2,84 @@
 #include "polyomino.hpp"
 #include <stdexcept>
 #include <nlohmann/json.hpp>
+#include "log.hpp"
 #include <iostream>
+#include <iterator>
 
 using json = nlohmann::json;
 
+namespace {
+// Indexed by the TYPE_* constants
+const char* const CELL_TYPE_NAMES[] = {
+    "", "line", "square", "star", "triangle", "nega", "poly", "ylop", "bridge", "arrow", "sizer", "unknown",
+};
+
+// Indexed by the PATH_* constants
+const char* const DIRECTION_NAMES[] = {"", "left", "right", "top", "bottom"};
+
+// Keys of puzzle.settings in engine/puzzle.js, by SETTINGS_FLAG_* bit
+const char* const SETTING_NAMES[] = {
+    "NEGATIONS_CANCEL_NEGATIONS", "SHAPELESS_ZERO_POLY", "PRECISE_POLYOMINOS",
+    "FLASH_FOR_ERRORS", "FAT_STARTPOINTS", "CUSTOM_MECHANICS",
+};
+}
+
+uint8_t cellTypeFromString(const std::string& type) {
+    if (type.empty()) return TYPE_NONE;
+    for (uint8_t i = TYPE_LINE; i < TYPE_UNKNOWN; i++) {
+        if (type == CELL_TYPE_NAMES[i]) return i;
+    }
+    return TYPE_UNKNOWN;
+}
+
+const char* cellTypeToString(uint8_t type) {
+    if (type > TYPE_UNKNOWN) return CELL_TYPE_NAMES[TYPE_UNKNOWN];
+    return CELL_TYPE_NAMES[type];
+}
+
+uint8_t directionFromString(const std::string& dir) {
+    for (uint8_t i = PATH_LEFT; i <= PATH_BOTTOM; i++) {
+        if (dir == DIRECTION_NAMES[i]) return i;
+    }
+    return PATH_NONE;
+}
+
+const char* directionToString(uint8_t dir) {
+    if (dir > PATH_BOTTOM) return DIRECTION_NAMES[PATH_NONE];
+    return DIRECTION_NAMES[dir];
+}
+
 Puzzle::Puzzle(int w, int h, bool p) : width(w), height(h), pillar(p) {    
-    // The actual grid size is 2*w+1 x 2*h+1
-    int actualWidth = 2 * w + 1;
-    int actualHeight = 2 * h + 1;
+    // The actual grid size is 2*w+1 x 2*h+1. Pillars wrap around, so the last column of
+    // edges is also the first one and is only stored once: 2*w x 2*h+1.
+    actualWidth = pillar ? 2 * w : 2 * w + 1;
+    actualHeight = 2 * h + 1;
     
-    grid.resize(actualWidth);
+    // One contiguous buffer; content cells (odd, odd) start empty and everything else is line
+    grid.resize(actualWidth * actualHeight);
     for (int x = 0; x < actualWidth; x++) {
-        grid[x].resize(actualHeight);
         for (int y = 0; y < actualHeight; y++) {
-            if (x % 2 == 1 && y % 2 == 1) {
-                grid[x][y] = Cell(); // Empty cell
-            } else {
-                Cell cell;
-                cell.type = "line";
-                grid[x][y] = cell;
+            if (x % 2 == 0 || y % 2 == 0) {
+                grid[index(x, y)].type = TYPE_LINE;
             }
         }
     }
+    
+    _buildNeighbors();
+    polyFitter = PolyFitter(actualWidth, actualHeight, pillar);
+}
+
+void Puzzle::_buildNeighbors() {
+    neighbors.resize(grid.size());
+    for (int x = 0; x < actualWidth; x++) {
+        for (int y = 0; y < actualHeight; y++) {
+            auto& n = neighbors[index(x, y)];
+            n[PATH_LEFT - PATH_LEFT] = x > 0 ? index(x - 1, y) : (pillar ? index(actualWidth - 1, y) : -1);
+            n[PATH_RIGHT - PATH_LEFT] = x < actualWidth - 1 ? index(x + 1, y) : (pillar ? index(0, y) : -1);
+            n[PATH_TOP - PATH_LEFT] = y > 0 ? index(x, y - 1) : -1;
+            n[PATH_BOTTOM - PATH_LEFT] = y < actualHeight - 1 ? index(x, y + 1) : -1;
+        }
+    }
 }
 
 std::unique_ptr<Puzzle> Puzzle::deserialize(const std::string& jsonStr) {    
@@ -35,20 +91,23 @@ std::unique_ptr<Puzzle> Puzzle::deserialize(const std::string& jsonStr) {
             throw std::runtime_error("Invalid grid format in JSON");
         }
         
-        // The actual grid size is 2*w+1 x 2*h+1
+        // The actual grid size is 2*w+1 x 2*h+1 (2*w x 2*h+1 for pillars)
         int actualWidth = j["grid"].size();
         int actualHeight = j["grid"][0].size();
         bool isPillar = j.value("pillar", false);
-        std::cout << "Actual grid size: " << actualWidth << "x" << actualHeight << " (pillar: " << isPillar << ")" << std::endl;
+        PUZZLE_LOG(LOG_DEBUG, "Actual grid size: " << actualWidth << "x" << actualHeight << " (pillar: " << isPillar << ")");
         
         // Calculate the logical dimensions (for the puzzle cells)
-        int w = (actualWidth - 1) / 2;
+        int w = isPillar ? actualWidth / 2 : (actualWidth - 1) / 2;
         int h = (actualHeight - 1) / 2;
         
         // Validate grid dimensions
         if (w <= 0 || h <= 0) {
             throw std::runtime_error("Invalid grid dimensions");
         }
+        if (isPillar && actualWidth % 2 != 0) {
+            throw std::runtime_error("Pillar puzzles must have an even grid width");
+        }
         
         // Validate that all rows have the same length
         for (size_t i = 0; i < j["grid"].size(); i++) {
@@ -57,20 +116,38 @@ std::unique_ptr<Puzzle> Puzzle::deserialize(const std::string& jsonStr) {
             }
         }
         
-        auto puzzle = std::make_unique<Puzzle>(w, h, isPillar);        
+        auto puzzle = std::make_unique<Puzzle>(w, h, isPillar);
+        if (j.contains("symmetry") && j["symmetry"].is_object()) {
+            const auto& symmetry = j["symmetry"];
+            puzzle->setSymmetry(true, symmetry.value("x", false), symmetry.value("y", false));
+        }
+        if (j.contains("settings") && j["settings"].is_object()) {
+            // Settings that are left out keep their defaults, as in Puzzle.deserialize
+            const auto& settings = j["settings"];
+            for (int bit = 0; bit < static_cast<int>(std::size(SETTING_NAMES)); bit++) {
+                if (!settings.contains(SETTING_NAMES[bit])) continue;
+                const auto& value = settings[SETTING_NAMES[bit]];
+                bool enabled = value.is_boolean() ? value.get<bool>() : value.is_number() && value != 0;
+                if (enabled) {
+                    puzzle->settingsFlags |= 1 << bit;
+                } else {
+                    puzzle->settingsFlags &= ~(1 << bit);
+                }
+            }
+        }
         // Copy grid data
         for (int x = 0; x < actualWidth; x++) {            
             // Validate row bounds
-            if (x >= puzzle->grid.size()) {
-                std::cerr << "Row index " << x << " out of bounds (grid size: " << puzzle->grid.size() << ")" << std::endl;
+            if (x >= puzzle->actualWidth) {
+                PUZZLE_LOG(LOG_ERROR, "Row index " << x << " out of bounds (grid size: " << puzzle->actualWidth << ")");
                 throw std::runtime_error("Row index out of bounds");
             }
             
             for (int y = 0; y < actualHeight; y++) {
                 // Validate column bounds
-                if (y >= puzzle->grid[x].size()) {
-                    std::cerr << "Column index " << y << " out of bounds for row " << x 
-                             << " (row size: " << puzzle->grid[x].size() << ")" << std::endl;
+                if (y >= puzzle->actualHeight) {
+                    PUZZLE_LOG(LOG_ERROR, "Column index " << y << " out of bounds for row " << x 
+                               << " (row size: " << puzzle->actualHeight << ")");
                     throw std::runtime_error("Column index out of bounds");
                 }
                 
@@ -80,18 +157,18 @@ std::unique_ptr<Puzzle> Puzzle::deserialize(const std::string& jsonStr) {
                 }
                 
                 try {
-                    Cell& targetCell = puzzle->grid[x][y];
+                    Cell& targetCell = puzzle->at(puzzle->index(x, y));
                     
                     if (cell.contains("start")) {
                         targetCell.start = cell["start"];
                     }
                     if (cell.contains("end")) {
-                        targetCell.end = cell["end"];
+                        targetCell.end = directionFromString(cell["end"]);
                     }
                     if (cell.contains("type")) {
-                        targetCell.type = cell["type"];
+                        targetCell.type = cellTypeFromString(cell["type"]);
                     }
-                    if (cell.contains("color")) {
+                    if (cell.contains("color") && cell["color"].is_number()) {
                         targetCell.color = cell["color"];
                     }
                     if (cell.contains("count")) {
@@ -128,19 +205,20 @@ std::unique_ptr<Puzzle> Puzzle::deserialize(const std::string& jsonStr) {
                         }
                     }
                 } catch (const std::exception& e) {
-                    std::cerr << "Error processing cell at " << x << "," << y << ": " << e.what() << std::endl;
+                    PUZZLE_LOG(LOG_ERROR, "Error processing cell at " << x << "," << y << ": " << e.what());
                     throw;
                 }
             }
         }
         
+        puzzle->_warnUnsupportedSettings();
         return puzzle;
         
     } catch (const json::parse_error& e) {
-        std::cerr << "JSON parse error: " << e.what() << std::endl;
+        PUZZLE_LOG(LOG_ERROR, "JSON parse error: " << e.what());
         throw;
     } catch (const std::exception& e) {
-        std::cerr << "Error during deserialization: " << e.what() << std::endl;
+        PUZZLE_LOG(LOG_ERROR, "Error during deserialization: " << e.what());
         throw;
     }
 }
@@ -150,15 +228,26 @@ std::string Puzzle::serialize() const {
     j["width"] = width;
     j["height"] = height;
     j["pillar"] = pillar;
+    if (hasSymmetry()) {
+        j["symmetry"] = {{"x", hasSymmetryX()}, {"y", hasSymmetryY()}};
+    }
+    if (settingsFlags != SETTINGS_DEFAULT) {
+        json settings;
+        for (int bit = 0; bit < static_cast<int>(std::size(SETTING_NAMES)); bit++) {
+            settings[SETTING_NAMES[bit]] = (settingsFlags & (1 << bit)) != 0;
+        }
+        j["settings"] = settings;
+    }
     
     json gridJson;
-    for (const auto& row : grid) {
+    for (int x = 0; x < actualWidth; x++) {
         json rowJson;
-        for (const auto& cell : row) {
+        for (int y = 0; y < actualHeight; y++) {
+            const Cell& cell = at(index(x, y));
             json cellJson;
             if (cell.start) cellJson["start"] = true;
-            if (!cell.end.empty()) cellJson["end"] = cell.end;
-            if (!cell.type.empty()) cellJson["type"] = cell.type;
+            if (cell.end != PATH_NONE) cellJson["end"] = directionToString(cell.end);
+            if (cell.type != TYPE_NONE) cellJson["type"] = cellTypeToString(cell.type);
             if (cell.color != 0) cellJson["color"] = cell.color;
             if (cell.count != 0) cellJson["count"] = cell.count;
             if (cell.polyshape != 0) cellJson["polyshape"] = cell.polyshape;
@@ -181,653 +270,463 @@ std::string Puzzle::serialize() const {
 Cell* Puzzle::getCell(int x, int y) {
     x = _mod(x);
     if (!_safeCell(x, y)) {
-        std::cout << "Cell access out of bounds: " << x << "," << y << std::endl;
+        PUZZLE_LOG(LOG_WARN, "Cell access out of bounds: " << x << "," << y);
         return nullptr;
     }
-    return &grid[x][y];
+    return &grid[index(x, y)];
 }
 
 void Puzzle::updateCell(int x, int y, const std::string& key, const json& value) {
     x = _mod(x);
     if (!_safeCell(x, y)) return;
     
-    Cell& cell = grid[x][y];
+    // Anything but the line can change a region's verdict
+    if (key != "line" && key != "dir") regionCache.clear();
+    
+    Cell& cell = grid[index(x, y)];
     if (key == "line") cell.line = value;
     else if (key == "gap") cell.gap = value;
     else if (key == "dot") cell.dot = value;
     else if (key == "color") cell.color = value;
     else if (key == "start") cell.start = value;
-    else if (key == "end") cell.end = value;
-    else if (key == "type") cell.type = value;
+    else if (key == "end") cell.end = directionFromString(value);
+    else if (key == "type") cell.type = cellTypeFromString(value);
     else if (key == "count") cell.count = value;
     else if (key == "polyshape") cell.polyshape = value;
-    else if (key == "dir") cell.dir = value;
+    else if (key == "dir") cell.dir = directionFromString(value);
 }
 
 void Puzzle::clearLines() {
-    for (int x = 0; x < width; x++) {
-        for (int y = 0; y < height; y++) {
-            updateCell(x, y, "line", LINE_NONE);
-            grid[x][y].dir.clear();
+    for (auto& cell : grid) {
+        cell.line = LINE_NONE;
+        cell.dir = PATH_NONE;
+    }
+}
+
+void Puzzle::setSymmetry(bool symmetrical, bool x, bool y) {
+    genericFlags &= ~(GENERIC_FLAG_SYMMETRICAL | GENERIC_FLAG_SYMMETRY_X | GENERIC_FLAG_SYMMETRY_Y);
+    if (symmetrical) {
+        genericFlags |= GENERIC_FLAG_SYMMETRICAL;
+        if (x) genericFlags |= GENERIC_FLAG_SYMMETRY_X;
+        if (y) genericFlags |= GENERIC_FLAG_SYMMETRY_Y;
+    }
+}
+
+int Puzzle::symmetricalIndex(int i) const {
+    int x = i / actualHeight;
+    int y = i % actualHeight;
+    if (hasSymmetry()) {
+        if (pillar) {
+            // Pillars mirror around the far side of the cylinder
+            x += actualWidth / 2;
+            if (hasSymmetryX()) x = actualWidth - x;
+            x = ((x % actualWidth) + actualWidth) % actualWidth;
+        } else if (hasSymmetryX()) {
+            x = (actualWidth - 1) - x;
         }
+        if (hasSymmetryY()) y = (actualHeight - 1) - y;
+    }
+    return index(x, y);
+}
+
+uint8_t Puzzle::symmetricalDir(uint8_t dir) const {
+    if (hasSymmetryX()) {
+        if (dir == PATH_LEFT) return PATH_RIGHT;
+        if (dir == PATH_RIGHT) return PATH_LEFT;
     }
+    if (hasSymmetryY()) {
+        if (dir == PATH_TOP) return PATH_BOTTOM;
+        if (dir == PATH_BOTTOM) return PATH_TOP;
+    }
+    return dir;
 }
 
 int Puzzle::_mod(int val) const {
     if (!pillar) return val;
-    return (val + width * height * 2) % width;
+    return ((val % actualWidth) + actualWidth) % actualWidth;
+}
+
+// Validation follows NEGATIONS_CANCEL_NEGATIONS, SHAPELESS_ZERO_POLY and PRECISE_POLYOMINOS, and
+// FLASH_FOR_ERRORS only changes how the web client shows a failure. The other settings change
+// which paths engine/validate.js accepts in ways the solver does not follow.
+void Puzzle::_warnUnsupportedSettings() const {
+    if (settingsFlags & SETTINGS_FLAG_CM) {
+        PUZZLE_LOG(LOG_WARN, "Puzzle sets CUSTOM_MECHANICS, which the solver does not "
+                   "support; its solutions may differ from the web client's");
+    }
+    if (settingsFlags & SETTINGS_FLAG_FS) return;
+    // Without FAT_STARTPOINTS, the web client counts a start in the middle of a segment as part
+    // of the regions around it, where the solver treats it as covered by the line
+    for (int x = 0; x < actualWidth; x++) {
+        for (int y = 0; y < actualHeight; y++) {
+            if (x % 2 != y % 2 && at(index(x, y)).start) {
+                PUZZLE_LOG(LOG_WARN, "Puzzle has a start in the middle of a segment "
+                           "without FAT_STARTPOINTS; its solutions may differ from the web client's");
+                return;
+            }
+        }
+    }
 }
 
 bool Puzzle::_safeCell(int x, int y) const {
-    if (x < 0 || x >= grid.size()) return false;
-    if (y < 0 || y >= grid[0].size()) return false;
+    if (x < 0 || x >= actualWidth) return false;
+    if (y < 0 || y >= actualHeight) return false;
     return true;
 }
 
-void Puzzle::_floodFill(int x, int y, std::vector<std::pair<int, int>>& region) {
-    Cell* cell = getCell(x, y);
-    if (!cell) return;
-    
-    // Skip if cell is already in the region
-    for (const auto& [rx, ry] : region) {
-        if (rx == x && ry == y) return;
-    }
+// Appends every cell reachable from seed without crossing the line to cells, and labels them.
+// Uses an explicit stack, visiting neighbors bottom, top, right, left, so the cells come out in
+// the same order as a recursive depth-first fill would produce them.
+void Puzzle::_fillRegion(int seed, int label, std::vector<int>& labels, std::vector<int>& cells) {
+    fillStack.clear();
+    fillStack.push_back(seed);
     
-    // For line cells, we can only pass through if there's NO line
-    if ((x % 2 == 0 || y % 2 == 0) && cell->line != LINE_NONE) {
-        return;
+    while (!fillStack.empty()) {
+        int i = fillStack.back();
+        fillStack.pop_back();
+        if (labels[i] != -1) continue;
+        
+        // For line cells, we can only pass through if there's NO line
+        int x = i / actualHeight;
+        int y = i % actualHeight;
+        if ((x % 2 == 0 || y % 2 == 0) && grid[i].line != LINE_NONE) continue;
+        
+        labels[i] = label;
+        cells.push_back(i);
+        
+        // Pushed in reverse, so that bottom is explored first
+        for (int direction : {PATH_LEFT, PATH_RIGHT, PATH_TOP, PATH_BOTTOM}) {
+            int next = neighbor(i, direction);
+            if (next >= 0 && labels[next] == -1) fillStack.push_back(next);
+        }
     }
-    
-    // Add cell to region
-    region.push_back({x, y});
-    
-    // Check all adjacent cells
-    if (y < grid[0].size() - 1) _floodFill(x, y + 1, region);
-    if (y > 0) _floodFill(x, y - 1, region);
-    if (x < grid.size() - 1) _floodFill(x + 1, y, region);
-    else if (pillar) _floodFill(0, y, region);
-    if (x > 0) _floodFill(x - 1, y, region);
-    else if (pillar) _floodFill(grid.size() - 1, y, region);
 }
 
+// Clears the line from every cell connected to (x, y) that engine/puzzle.js would reach. Uses the
+// same explicit stack as _fillRegion rather than recursing once per cell.
 void Puzzle::_floodFillOutside(int x, int y) {
-    Cell* cell = getCell(x, y);
-    if (!cell || cell->line == LINE_NONE) return;
-    
-    if (x % 2 != y % 2 && cell->gap != GAP_FULL) return;
-    if (x % 2 == 0 && y % 2 == 0 && cell->dot != DOT_NONE) return;
+    fillStack.clear();
+    if (_safeCell(x, y)) fillStack.push_back(index(x, y));
     
-    cell->line = LINE_NONE;
-    
-    if (x % 2 == 0 && y % 2 == 0) return;
+    while (!fillStack.empty()) {
+        int i = fillStack.back();
+        fillStack.pop_back();
+        
+        Cell& cell = grid[i];
+        if (cell.line == LINE_NONE) continue;
+        
+        x = i / actualHeight;
+        y = i % actualHeight;
+        if (x % 2 != y % 2 && cell.gap != GAP_FULL) continue;
+        if (x % 2 == 0 && y % 2 == 0 && cell.dot != DOT_NONE) continue;
+        
+        cell.line = LINE_NONE;
+        
+        if (x % 2 == 0 && y % 2 == 0) continue;
+        
+        // Pushed in reverse, so that bottom is explored first
+        for (int direction : {PATH_LEFT, PATH_RIGHT, PATH_TOP, PATH_BOTTOM}) {
+            int next = neighbor(i, direction);
+            if (next >= 0) fillStack.push_back(next);
+        }
+    }
+}
+
+const RegionMap& Puzzle::labelRegions() {
+    regionMap.labels.assign(grid.size(), -1);
+    regionMap.cells.clear();
+    regionMap.starts.assign(1, 0);
     
-    if (y < height - 1) _floodFillOutside(x, y + 1);
-    if (y > 0) _floodFillOutside(x, y - 1);
-    if (x < width - 1) _floodFillOutside(x + 1, y);
-    else if (pillar) _floodFillOutside(0, y);
-    if (x > 0) _floodFillOutside(x - 1, y);
-    else if (pillar) _floodFillOutside(width - 1, y);
+    // Seed each region from its first cell in x, y order, as getRegions in engine/puzzle.js does,
+    // so that cells are listed in the same order. Negations depend on it.
+    for (int i = 0; i < size(); i++) {
+        if (regionMap.labels[i] != -1 || grid[i].line != LINE_NONE) continue;
+        
+        _fillRegion(i, regionMap.count(), regionMap.labels, regionMap.cells);
+        regionMap.starts.push_back(static_cast<int>(regionMap.cells.size()));
+    }
+    return regionMap;
 }
 
 std::vector<std::vector<std::pair<int, int>>> Puzzle::getRegions() {
-    std::vector<std::vector<std::pair<int, int>>> regions;
+    const auto& map = labelRegions();
     
-    // Create a copy of the grid for flood fill
-    auto tempGrid = grid;
-    
-    // Find regions starting from content cells (squares, etc.)
-    for (int x = 1; x < grid.size(); x += 2) {
-        for (int y = 1; y < grid[0].size(); y += 2) {
-            bool alreadyInRegion = false;
-            
-            // Check if this cell is already in a region
-            for (const auto& region : regions) {
-                for (const auto& [rx, ry] : region) {
-                    if (rx == x && ry == y) {
-                        alreadyInRegion = true;
-                        break;
-                    }
-                }
-                if (alreadyInRegion) break;
-            }
-            
-            if (alreadyInRegion) continue;
-            
-            // Start a new region from this content cell
-            std::vector<std::pair<int, int>> region;
-            _floodFill(x, y, region);
-            
-            if (!region.empty()) {
-                regions.push_back(region);
-            }
+    std::vector<std::vector<std::pair<int, int>>> regions(map.count());
+    for (int r = 0; r < map.count(); r++) {
+        for (const int* i = map.begin(r); i != map.end(r); i++) {
+            regions[r].push_back({*i / actualHeight, *i % actualHeight});
         }
     }
     return regions;
 }
 
-std::vector<std::pair<int, int>> Puzzle::getRegion(int x, int y) {
+const std::vector<int>& Puzzle::getRegionCells(int x, int y) {
+    regionCells.clear();
     x = _mod(x);
-    if (!_safeCell(x, y)) return {};
-    
-    // Create a copy of the grid for flood fill
-    auto tempGrid = grid;
+    if (!_safeCell(x, y)) return regionCells;
     
-    std::vector<std::pair<int, int>> region;
-    _floodFill(x, y, region);
+    fillLabels.assign(grid.size(), -1);
+    _fillRegion(index(x, y), 0, fillLabels, regionCells);
     
-    // Restore the grid
-    grid = tempGrid;
+    // Re-fill from the same seed labelRegions() would use (the first cell in x, y order), so that
+    // validateRegion sees the cells in the same order as during a full validate().
+    int seed = -1;
+    for (int i : regionCells) {
+        if (seed == -1 || i < seed) seed = i;
+    }
+    if (seed != -1 && seed != regionCells.front()) {
+        regionCells.clear();
+        fillLabels.assign(grid.size(), -1);
+        _fillRegion(seed, 0, fillLabels, regionCells);
+    }
     
+    return regionCells;
+}
+
+std::vector<std::pair<int, int>> Puzzle::getRegion(int x, int y) {
+    std::vector<std::pair<int, int>> region;
+    for (int i : getRegionCells(x, y)) {
+        region.push_back({i / actualHeight, i % actualHeight});
+    }
     return region;
 }
 
 bool Puzzle::validate() {
     // First check for gaps in the path
-    for (int x = 0; x < grid.size(); x++) {
-        for (int y = 0; y < grid[0].size(); y++) {
-            Cell* cell = getCell(x, y);
-            if (!cell) continue;
-            
-            // Skip content cells and cells with lines
-            if (x % 2 == 1 && y % 2 == 1) continue;
-            if (cell->line != LINE_NONE) continue;
-            
-            // Count adjacent lines and check their directions
-            int adjacentLines = 0;
-            bool hasVertical = false;
-            bool hasHorizontal = false;
-            
-            // Check vertical neighbors
-            if (y > 0 && getCell(x, y - 1) && getCell(x, y - 1)->line != LINE_NONE) {
-                adjacentLines++;
-                hasVertical = true;
-            }
-            if (y < grid[0].size() - 1 && getCell(x, y + 1) && getCell(x, y + 1)->line != LINE_NONE) {
-                adjacentLines++;
-                hasVertical = true;
-            }
-            
-            // Check horizontal neighbors
-            if (x > 0 && getCell(x - 1, y) && getCell(x - 1, y)->line != LINE_NONE) {
-                adjacentLines++;
-                hasHorizontal = true;
-            }
-            if (x < grid.size() - 1 && getCell(x + 1, y) && getCell(x + 1, y)->line != LINE_NONE) {
-                adjacentLines++;
-                hasHorizontal = true;
-            }
-            
-            // It's only a gap if we have lines in both directions
-            if (adjacentLines >= 2 && hasVertical && hasHorizontal) {
-                std::cout << "Found gap in path at " << x << "," << y << std::endl;
+    for (int i = 0; i < size(); i++) {
+        const Cell& cell = grid[i];
+        
+        // Skip content cells and cells with lines
+        int x = i / actualHeight;
+        int y = i % actualHeight;
+        if (x % 2 == 1 && y % 2 == 1) continue;
+        if (cell.line != LINE_NONE) {
+            // In symmetry puzzles, colored dots must be covered by the line of their color
+            if ((cell.dot == DOT_BLUE && cell.line == LINE_YELLOW) ||
+                (cell.dot == DOT_YELLOW && cell.line == LINE_BLUE)) {
                 return false;
             }
+            continue;
+        }
+        
+        // Check vertical and horizontal neighbors
+        auto hasLine = [&](int direction) {
+            int next = neighbor(i, direction);
+            return next >= 0 && grid[next].line != LINE_NONE;
+        };
+        bool hasVertical = hasLine(PATH_TOP) || hasLine(PATH_BOTTOM);
+        bool hasHorizontal = hasLine(PATH_LEFT) || hasLine(PATH_RIGHT);
+        
+        // It's only a gap if we have lines in both directions
+        if (hasVertical && hasHorizontal) {
+            PUZZLE_LOG(LOG_DEBUG, "Found gap in path at " << x << "," << y);
+            return false;
         }
     }
+    
+    // Check each region
+    const auto& map = labelRegions();
+    for (int r = 0; r < map.count(); r++) {
+        if (!validateRegion(map.begin(r), map.end(r))) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool Puzzle::validateRegion(const int* first, const int* last) {
+    // Every line-free cell next to a region's cells is in the region too, so its cells decide
+    // which dots are uncovered and how many lines each triangle touches
+    regionMask.assign((grid.size() + 63) / 64, 0);
+    bool constrained = false;
+    for (const int* i = first; i != last; i++) {
+        regionMask[*i >> 6] |= uint64_t(1) << (*i & 63);
+        const Cell& cell = grid[*i];
+        if (cell.dot > DOT_NONE || cell.type > TYPE_LINE) constrained = true;
+    }
+    
+    // Without dots or symbols there is nothing to break
+    if (!constrained) {
+        return true;
+    }
+    if (const RegionVerdict* cached = regionCache.find(regionMask)) {
+        return cached->valid;
+    }
+    
+    regionPositions.clear();
+    for (const int* i = first; i != last; i++) {
+        regionPositions.push_back({*i / actualHeight, *i % actualHeight});
+    }
+    RegionVerdict verdict = _checkRegion(regionPositions);
+    regionCache.insert(regionMask, verdict);
+    return verdict.valid;
+}
+
+bool Puzzle::validateRegion(const std::vector<std::pair<int, int>>& region) {
+    return _checkRegion(region).valid;
+}
 
+// Validates the symbols of a single region against the current line state, as validateRegion
+// and regionCheck in engine/validate.js do.
+// Used by validate() and by the solver to check regions that the path has closed off.
+RegionVerdict Puzzle::_checkRegion(const std::vector<std::pair<int, int>>& region) {
+    squares.clear();
+    stars.clear();
+    triangles.clear();
+    polys.clear();
+    std::array<int, 256> coloredObjects{};  // color -> count, of every symbol with a color
+    int squareColor = -1;  // -1 means no squares found yet
+    bool squareClash = false;
+    int negations = 0;
     
-    // Get all regions
-    auto regions = getRegions();
+    // Uncovered dots, broken triangles and lone stars can only be made valid by negating them
+    // ("very invalid"). Squares, stars and polyominos might also be by negating something else.
+    int veryInvalid = 0;
+    int invalid = 0;
     
-    // Check each region
-    for (const auto& region : regions) {
-        std::vector<std::pair<int, int>> squares;
-        std::vector<std::pair<int, int>> stars;
-        std::vector<std::pair<int, int>> triangles;
-        std::vector<std::pair<int, int>> negations;
-        std::vector<std::pair<int, int>> polys;     // Regular polyominos
-        std::vector<std::pair<int, int>> ylops;     // Inverse polyominos
-        std::map<int, int> coloredObjects;  // color -> count
-        int squareColor = -1;  // -1 means no squares found yet
-        std::vector<std::pair<int, int>> regionInvalidElements;
+    // First pass: collect all symbols and check for uncovered dots and triangles
+    for (const auto& [x, y] : region) {
+        Cell* cell = getCell(x, y);
+        if (!cell) continue;
         
-        // First pass: collect all symbols and check for uncovered dots
-        for (const auto& [x, y] : region) {
-            Cell* cell = getCell(x, y);
-            if (!cell) continue;
-            
-            // Check for uncovered dots in this region
-            if (cell->dot) {
-                if (cell->line == LINE_NONE) {
-                    regionInvalidElements.push_back({x, y});
-                }
-            }
-            
-            // Only check colored objects at odd coordinates
-            if (x % 2 == 1 && y % 2 == 1) {
-                if (cell->type == "square") {
-                    if (squareColor == -1) {
-                        squareColor = cell->color;
-                    }
-                    squares.push_back({x, y});
-                    coloredObjects[cell->color]++;
-                }
-                else if (cell->type == "star") {
-                    stars.push_back({x, y});
-                    coloredObjects[cell->color]++;
-                }
-                else if (cell->type == "triangle") {
-                    triangles.push_back({x, y});
-                }
-                else if (cell->type == "nega") {
-                    negations.push_back({x, y});
-                }
-                else if (cell->type == "poly") {
-                    polys.push_back({x, y});
-                }
-                else if (cell->type == "ylop") {
-                    ylops.push_back({x, y});
-                }
-            }
+        // Check for uncovered dots in this region
+        if (cell->dot && cell->line == LINE_NONE) {
+            veryInvalid++;
         }
-
-        // Second pass: check for invalid elements
-        // Check squares of different colors
-        for (const auto& [x, y] : squares) {
-            Cell* cell = getCell(x, y);
-            if (cell && cell->color != squareColor) {
-                regionInvalidElements.push_back({x, y});
-            }
+        
+        // Symbols are only at odd coordinates
+        if (x % 2 == 0 || y % 2 == 0) continue;
+        int i = index(x, y);
+        if (cell->type > TYPE_LINE && cell->color != 0) {
+            coloredObjects[cell->color]++;
         }
-
-        // Check stars (must come in pairs)
-        for (const auto& [color, count] : coloredObjects) {
-            if (count == 1 || count > 2) {
-                // Add all stars of this color to invalid elements
-                for (const auto& [x, y] : stars) {
-                    Cell* cell = getCell(x, y);
-                    if (cell && cell->color == color) {
-                        regionInvalidElements.push_back({x, y});
-                    }
-                }
+        
+        if (cell->type == TYPE_SQUARE && cell->color != 0) {
+            if (squareColor == -1) {
+                squareColor = cell->color;
+            } else if (squareColor != cell->color) {
+                squareClash = true;
             }
+            squares.push_back(i);
         }
-
-        // Check triangles
-        for (const auto& [x, y] : triangles) {
-            Cell* cell = getCell(x, y);
-            if (!cell) continue;
-            
-            // Count adjacent lines
+        else if (cell->type == TYPE_STAR && cell->color != 0) {
+            stars.push_back(i);
+        }
+        else if (cell->type == TYPE_TRIANGLE) {
             int adjacentLines = 0;
-            if (getCell(x - 1, y) && getCell(x - 1, y)->line != LINE_NONE) adjacentLines++;
-            if (getCell(x + 1, y) && getCell(x + 1, y)->line != LINE_NONE) adjacentLines++;
-            if (getCell(x, y - 1) && getCell(x, y - 1)->line != LINE_NONE) adjacentLines++;
-            if (getCell(x, y + 1) && getCell(x, y + 1)->line != LINE_NONE) adjacentLines++;
-            
+            for (int direction = PATH_LEFT; direction <= PATH_BOTTOM; direction++) {
+                int next = neighbor(i, direction);
+                if (next >= 0 && grid[next].line != LINE_NONE) adjacentLines++;
+            }
             if (adjacentLines != cell->count) {
-                regionInvalidElements.push_back({x, y});
+                veryInvalid++;
+            } else {
+                triangles.push_back(i);
             }
         }
-
-        // Check polyominos and ylops
-        if (!polys.empty() || !ylops.empty()) {
-            // Count region size (only odd-coordinate cells)
-            int regionSize = 0;
-            for (const auto& pos : region) {
-                if (pos.first % 2 == 1 && pos.second % 2 == 1) {
-                    regionSize++;
-                }
-            }
-            
-            // Calculate total poly and ylop sizes
-            int polySize = 0;  // Total size of all polys
-            int ylopSize = 0;  // Total size of all ylops
-            std::vector<uint32_t> polyShapes;
-            std::vector<uint32_t> ylopShapes;
-            std::vector<std::pair<int, int>> polyPositions;
-            std::vector<std::pair<int, int>> ylopPositions;
-            
-            for (const auto& [x, y] : polys) {
-                Cell* cell = getCell(x, y);
-                if (cell && cell->polyshape > 0) {
-                    polyShapes.push_back(cell->polyshape);
-                    polyPositions.push_back({x, y});
-                    polySize += getPolySize(cell->polyshape);
-                }
-            }
-            
-            for (const auto& [x, y] : ylops) {
-                Cell* cell = getCell(x, y);
-                if (cell && cell->polyshape > 0) {
-                    ylopShapes.push_back(cell->polyshape);
-                    ylopPositions.push_back({x, y});
-                    ylopSize += getPolySize(cell->polyshape);
-                }
-            }
-            
-            // If we have polyominos or ylops, make sure they correctly fit the region
-            if (!polyShapes.empty() || !ylopShapes.empty()) {
-
-                // Check if the math works out: poly_size = region_size + ylop_size
-                // (Polys must cover the original region plus the ylop extension)
-                if (polySize != regionSize + ylopSize) {
-                    
-                    // Instead of immediately returning false, mark all polys and ylops as invalid
-                    for (const auto& pos : polys) {
-                        regionInvalidElements.push_back(pos);
-                    }
-                    for (const auto& pos : ylops) {
-                        regionInvalidElements.push_back(pos);
-                    }
-                } else {
-                    // Create working grid for validation
-                    std::vector<std::vector<int>> workingGrid(grid.size(), std::vector<int>(grid[0].size(), 0));
-                    
-                    // Mark cells in the region as needing coverage (-1)
-                    for (const auto& pos : region) {
-                        if (pos.first % 2 == 1 && pos.second % 2 == 1) {
-                            workingGrid[pos.first][pos.second] = -1; // Region cells start as -1
-                        }
-                    }
-                    
-                    // Place ylops to extend the region
-                    bool ylopPlacementFailed = false;
-                    for (size_t i = 0; i < ylopShapes.size(); i++) {
-                        auto shape = ylopShapes[i];
-                        
-                        std::cout << "Placing ylop shape " << shape << std::endl;
-                        
-                        // Find all positions adjacent to the region to try placing the ylop
-                        std::vector<std::pair<int, int>> candidatePositions;
-                        
-                        // First collect all cells adjacent to the region
-                        for (const auto& pos : region) {
-                            if (pos.first % 2 == 1 && pos.second % 2 == 1) {
-                                // Check all 4 adjacent cells (if they're not in the region)
-                                std::vector<std::pair<int, int>> adjacentPositions = {
-                                    {pos.first + 2, pos.second},
-                                    {pos.first - 2, pos.second},
-                                    {pos.first, pos.second + 2},
-                                    {pos.first, pos.second - 2}
-                                };
-                                
-                                for (const auto& adjPos : adjacentPositions) {
-                                    // Skip if outside grid
-                                    if (adjPos.first < 0 || adjPos.second < 0 || 
-                                        adjPos.first >= static_cast<int>(grid.size()) || 
-                                        adjPos.second >= static_cast<int>(grid[0].size())) {
-                                        continue;
-                                    }
-                                    
-                                    // Skip if part of the region
-                                    bool inRegion = false;
-                                    for (const auto& regionPos : region) {
-                                        if (regionPos.first == adjPos.first && regionPos.second == adjPos.second) {
-                                            inRegion = true;
-                                            break;
-                                        }
-                                    }
-                                    if (inRegion) continue;
-                                    
-                                    // Add to candidate positions
-                                    bool alreadyAdded = false;
-                                    for (const auto& candPos : candidatePositions) {
-                                        if (candPos.first == adjPos.first && candPos.second == adjPos.second) {
-                                            alreadyAdded = true;
-                                            break;
-                                        }
-                                    }
-                                    if (!alreadyAdded) {
-                                        candidatePositions.push_back(adjPos);
-                                    }
-                                }
-                            }
-                        }
-                        
-                        // If no adjacent positions, also try the original ylop position
-                        if (candidatePositions.empty() && i < ylopPositions.size()) {
-                            candidatePositions.push_back(ylopPositions[i]);
-                        }
-                        
-                        // Try to place the ylop at any valid position
-                        bool placed = false;
-                        std::vector<uint32_t> rotations = getRotations(shape);
-                        
-                        for (const auto& position : candidatePositions) {
-                            for (auto rotation : rotations) {
-                                auto cells = polyominoFromPolyshape(rotation, true); // ylop=true
-                                std::vector<std::pair<int, int>> cellsToConvert;
-                                
-                                // Only mark cells outside the region
-                                bool valid = true;
-                                for (const auto& cell : cells) {
-                                    int newX = position.first + cell.first;
-                                    int newY = position.second + cell.second;
-                                    
-                                    // Skip if outside grid
-                                    if (newX < 0 || newY < 0 || newX >= static_cast<int>(grid.size()) || 
-                                        newY >= static_cast<int>(grid[0].size())) {
-                                        continue;
-                                    }
-                                    
-                                    // Only consider actual cells (odd coordinates)
-                                    if (newX % 2 != 1 || newY % 2 != 1) {
-                                        continue;
-                                    }
-                                    
-                                    // Check if in region
-                                    bool inRegion = false;
-                                    for (const auto& pos : region) {
-                                        if (pos.first == newX && pos.second == newY) {
-                                            inRegion = true;
-                                            break;
-                                        }
-                                    }
-                                    
-                                    // If the cell is already in the region, this isn't valid
-                                    if (inRegion) {
-                                        valid = false;
-                                        break;
-                                    }
-                                    
-                                    // This is a cell we should convert
-                                    cellsToConvert.push_back({newX, newY});
-                                }
-                                
-                                if (valid && !cellsToConvert.empty()) {
-                                    // Mark cells outside the region as needing coverage (-1)
-                                    for (const auto& cell : cellsToConvert) {
-                                        std::cout << "  Marking cell " << cell.first << "," << cell.second 
-                                                << " as needing coverage (ylop extension)" << std::endl;
-                                        workingGrid[cell.first][cell.second] = -1;
-                                    }
-                                    placed = true;
-                                    break;
-                                }
-                            }
-                            if (placed) break;
-                        }
-                        
-                        if (!placed) {
-                            std::cout << "Failed to place ylop shape " << shape << " anywhere" << std::endl;
-                            // Mark the ylop as invalid and continue
-                            if (i < ylopPositions.size()) {
-                                regionInvalidElements.push_back(ylopPositions[i]);
-                            }
-                            ylopPlacementFailed = true;
-                            break;
-                        }
-                    }
-                    
-                    // Only try placing polys if ylop placement didn't fail
-                    if (!ylopPlacementFailed) {
-                        // Place regular polyominos to provide needed coverage
-                        bool polyPlacementFailed = false;
-                        for (size_t i = 0; i < polyShapes.size(); i++) {
-                            auto shape = polyShapes[i];
-                            
-                            // Collect all cells in the region that need coverage
-                            std::vector<std::pair<int, int>> candidatePositions;
-                            for (const auto& pos : region) {
-                                if (pos.first % 2 == 1 && pos.second % 2 == 1 && workingGrid[pos.first][pos.second] == -1) {
-                                    candidatePositions.push_back(pos);
-                                }
-                            }
-                            
-                            // If no positions in region, also include the extended region from ylops
-                            if (candidatePositions.empty()) {
-                                for (int x = 1; x < grid.size(); x += 2) {
-                                    for (int y = 1; y < grid[0].size(); y += 2) {
-                                        if (workingGrid[x][y] == -1) {
-                                            candidatePositions.push_back({x, y});
-                                        }
-                                    }
-                                }
-                            }
-                            
-                            // If still no positions, also try the original poly position
-                            if (candidatePositions.empty() && i < polyPositions.size()) {
-                                candidatePositions.push_back(polyPositions[i]);
-                            }
-                            
-                            // Try to place the poly at any valid position
-                            bool placed = false;
-                            std::vector<uint32_t> rotations = getRotations(shape);
-                            
-                            for (const auto& position : candidatePositions) {
-                                for (auto rotation : rotations) {
-                                    auto cells = polyominoFromPolyshape(rotation, false);
-                                    std::vector<std::pair<int, int>> cellsToUpdate;
-                                    std::vector<int> originalValues;
-                                    
-                                    // Check if this placement is valid
-                                    bool valid = true;
-                                    for (const auto& cell : cells) {
-                                        int newX = position.first + cell.first;
-                                        int newY = position.second + cell.second;
-                                        
-                                        // Skip if outside grid
-                                        if (newX < 0 || newY < 0 || newX >= static_cast<int>(grid.size()) || 
-                                            newY >= static_cast<int>(grid[0].size())) {
-                                            valid = false;
-                                            break;
-                                        }
-                                        
-                                        // Only consider actual cells (odd coordinates)
-                                        if (newX % 2 != 1 || newY % 2 != 1) {
-                                            continue;
-                                        }
-                                        
-                                        // Poly can only cover cells that need coverage (-1)
-                                        if (workingGrid[newX][newY] != -1) {
-                                            valid = false;
-                                            break;
-                                        }
-                                        
-                                        // This is a cell we can update
-                                        cellsToUpdate.push_back({newX, newY});
-                                        originalValues.push_back(workingGrid[newX][newY]);
-                                    }
-                                    
-                                    if (valid && !cellsToUpdate.empty()) {
-                                        // Mark cells as covered (0)
-                                        for (const auto& cell : cellsToUpdate) {
-                                            workingGrid[cell.first][cell.second] = 0;
-                                        }
-                                        placed = true;
-                                        break;
-                                    }
-                                }
-                                if (placed) break;
-                            }
-                            
-                            if (!placed) {
-                                // Mark the poly as invalid and continue
-                                if (i < polyPositions.size()) {
-                                    regionInvalidElements.push_back(polyPositions[i]);
-                                }
-                                polyPlacementFailed = true;
-                                break;
-                            }
-                        }
-                        
-                        // If all polys were placed, check if region is fully covered
-                        if (!polyPlacementFailed) {
-                            bool uncoveredCells = false;
-                            // Check if all cells (original region + ylop extensions) have been correctly covered
-                            for (int x = 1; x < grid.size(); x += 2) {
-                                for (int y = 1; y < grid[0].size(); y += 2) {
-                                    if (workingGrid[x][y] < 0) {
-                                        std::cout << "Cell at " << x << "," << y 
-                                                << " not covered (value: " << workingGrid[x][y] << ")" << std::endl;
-                                        uncoveredCells = true;
-                                    }
-                                }
-                            }
-                            
-                            // If there are uncovered cells, mark all polys and ylops as invalid
-                            if (uncoveredCells) {
-                                for (const auto& pos : polys) {
-                                    regionInvalidElements.push_back(pos);
-                                }
-                                for (const auto& pos : ylops) {
-                                    regionInvalidElements.push_back(pos);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+        else if (cell->type == TYPE_NEGA) {
+            negations++;
         }
-
-        // If there are no negations in this region, check if there are any invalid elements
-        if (negations.empty()) {
-            if (!regionInvalidElements.empty()) {
-                return false;
-            }
-            continue;
+        else if (cell->type == TYPE_POLY || cell->type == TYPE_YLOP) {
+            polys.push_back(i);
         }
-
-        // Handle negations
-        // First, pair up negations that can cancel each other
-        int remainingNegations = negations.size();
-        if (remainingNegations >= 2) {
-            // Each pair of negations can cancel each other
-            remainingNegations = remainingNegations % 2;
+    }
+    
+    // Squares of more than one color are all invalid
+    if (squareClash) {
+        invalid += static_cast<int>(squares.size());
+    }
+    
+    // Stars need exactly one other symbol of their color
+    for (int i : stars) {
+        int count = coloredObjects[grid[i].color];
+        if (count == 1) {
+            veryInvalid++;
+        } else if (count > 2) {
+            invalid++;
         }
-
-        // Any remaining negations must each cancel exactly one invalid element
-        if (remainingNegations > 0) {
-            // If there are no invalid elements but we have remaining negations, the puzzle is invalid
-            if (regionInvalidElements.empty()) {
-                return false;
-            }
-
-            // Each remaining negation must cancel exactly one invalid element
-            if (remainingNegations != regionInvalidElements.size()) {
-                return false;
-            }
-        } else {
-            // If all negations cancelled each other, there should be no invalid elements
-            if (!regionInvalidElements.empty()) {
-                return false;
-            }
+    }
+    
+    // If the shapes can't tile the region, every polyomino and onimoylop in it is invalid
+    bool polysFit = true;
+    if (!polys.empty()) {
+        // Membership lookups for the fitter, cleared again before returning
+        inRegion.resize(grid.size());
+        for (const auto& pos : region) {
+            inRegion[index(pos.first, pos.second)] = 1;
+        }
+        
+        polyShapes.clear();
+        ylopShapes.clear();
+        for (int i : polys) {
+            if (grid[i].polyshape == 0) continue;
+            (grid[i].type == TYPE_POLY ? polyShapes : ylopShapes).push_back(grid[i].polyshape);
+        }
+        polysFit = polyFitter.fit(inRegion, polyShapes, ylopShapes, settingsFlags);
+        if (!polysFit) {
+            invalid += static_cast<int>(polys.size());
         }
     }
     
-    return true;
+    RegionVerdict verdict;
+    verdict.invalidElements = veryInvalid + invalid;
+    
+    // Each very invalid element takes a negation, and the resolver decides whether the rest can
+    // cancel the other invalid elements
+    if (negations == 0 || veryInvalid > negations) {
+        verdict.valid = verdict.invalidElements == 0;
+    } else {
+        negationResolver.clear();
+        for (int i : squares) {
+            negationResolver.addSymbol(TYPE_SQUARE, grid[i].color, 0, squareClash);
+        }
+        for (int i : stars) {
+            int count = coloredObjects[grid[i].color];
+            if (count == 1) continue;
+            negationResolver.addSymbol(TYPE_STAR, grid[i].color, 0, count > 2);
+        }
+        for (int i : polys) {
+            negationResolver.addSymbol(grid[i].type, grid[i].color, grid[i].polyshape, !polysFit);
+        }
+        for (int i : triangles) {
+            negationResolver.addSymbol(TYPE_TRIANGLE, grid[i].color, 0, false);
+        }
+        
+        verdict.valid = negationResolver.resolve(
+            negations - veryInvalid, settingsFlags & SETTINGS_FLAG_NCN,
+            [&](const std::vector<uint32_t>& polys, const std::vector<uint32_t>& ylops) {
+                return polyFitter.fit(inRegion, polys, ylops, settingsFlags);
+            });
+    }
+    
+    if (!polys.empty()) {
+        for (const auto& pos : region) {
+            inRegion[index(pos.first, pos.second)] = 0;
+        }
+    }
+    return verdict;
 }
 
 void Puzzle::printBoard() const {
     // Print column numbers
     std::cout << "   ";
-    for (int x = 0; x < grid.size(); x++) {
+    for (int x = 0; x < actualWidth; x++) {
         std::cout << x % 10 << " ";
     }
     std::cout << "\n";
     
     // Print the grid
-    for (int y = 0; y < grid[0].size(); y++) {
+    for (int y = 0; y < actualHeight; y++) {
         // Print row number
         std::cout << y % 10 << "  ";
         
-        for (int x = 0; x < grid.size(); x++) {
-            const auto& cell = grid[x][y];
+        for (int x = 0; x < actualWidth; x++) {
+            const auto& cell = at(index(x, y));
             
             if (cell.start) {
                 std::cout << "S ";
-            } else if (!cell.end.empty()) {
+            } else if (cell.end != PATH_NONE) {
                 std::cout << "E ";
             } else if (cell.dot > DOT_NONE) {
                 std::cout << "• ";
@@ -835,25 +734,25 @@ void Puzzle::printBoard() const {
                 std::cout << "█ ";
             } else if (cell.gap > GAP_NONE) {
                 std::cout << "╌ ";
-            } else if (cell.type == "line") {
+            } else if (cell.type == TYPE_LINE) {
                 std::cout << "· ";
-            } else if (cell.type == "square") {
+            } else if (cell.type == TYPE_SQUARE) {
                 // Print squares with their color number
-                std::cout << "s" << cell.color;
-            } else if (cell.type == "star") {
+                std::cout << "s" << static_cast<int>(cell.color);
+            } else if (cell.type == TYPE_STAR) {
                 // Print stars with their color number
-                std::cout << "*" << cell.color;
-            } else if (cell.type == "triangle") {
+                std::cout << "*" << static_cast<int>(cell.color);
+            } else if (cell.type == TYPE_TRIANGLE) {
                 // Print triangles with their count
-                std::cout << "△" << cell.count;
-            } else if (cell.type == "nega") {
+                std::cout << "△" << static_cast<int>(cell.count);
+            } else if (cell.type == TYPE_NEGA) {
                 // Print negation symbols (N for black, n for white)
                 std::cout << (cell.nega == NEGA_WHITE ? "n " : "N ");
-            } else if (cell.type == "poly") {
+            } else if (cell.type == TYPE_POLY) {
                 // Print polyominos with P and show size
                 int size = getPolySize(cell.polyshape);
                 std::cout << "P" << size;
-            } else if (cell.type == "ylop") {
+            } else if (cell.type == TYPE_YLOP) {
                 // Print ylops with Y and show size
                 int size = getPolySize(cell.polyshape);
                 std::cout << "Y" << size;
@@ -881,13 +780,13 @@ bool Puzzle::placeShapesRecursively(const std::vector<std::pair<int, int>>& posi
     uint32_t shape = shapes[shapeIndex];
     
     // Try all rotations of the shape
-    std::vector<uint32_t> rotations = getRotations(shape);
+    const auto& info = polyshapeInfo(shape);
     
     // Try placing the polyomino at each possible position in the region
     for (const auto& position : positions) {
-        for (auto rotation : rotations) {
-            // Generate cell coordinates for this shape based on rotation
-            auto cells = polyominoFromPolyshape(rotation, false);
+        for (const auto& rotation : info) {
+            // Cell coordinates for this shape based on rotation
+            auto cells = rotation.precise;
             
             // Try to place the shape at this position
             // Polys add +1 to cells, canceling out the -1
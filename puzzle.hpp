@@ -3,8 +3,12 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <array>
 #include <nlohmann/json.hpp>
 #include <cstdint>
+#include "polyomino.hpp"
+#include "region_cache.hpp"
+#include "negation_resolver.hpp"
 
 using json = nlohmann::json;
 
@@ -37,24 +41,75 @@ constexpr int NEGA_NONE = 0;
 constexpr int NEGA_BLACK = 1;
 constexpr int NEGA_WHITE = 2;
 
+// Constants for cell types (the "type" string in JSON)
+constexpr uint8_t TYPE_NONE = 0;
+constexpr uint8_t TYPE_LINE = 1;
+constexpr uint8_t TYPE_SQUARE = 2;
+constexpr uint8_t TYPE_STAR = 3;
+constexpr uint8_t TYPE_TRIANGLE = 4;
+constexpr uint8_t TYPE_NEGA = 5;
+constexpr uint8_t TYPE_POLY = 6;
+constexpr uint8_t TYPE_YLOP = 7;
+constexpr uint8_t TYPE_BRIDGE = 8;
+constexpr uint8_t TYPE_ARROW = 9;
+constexpr uint8_t TYPE_SIZER = 10;
+constexpr uint8_t TYPE_UNKNOWN = 11;  // Any other type string; not validated
+
+// Flags of the binary format in engine/serializer.js
+constexpr uint8_t GENERIC_FLAG_AUTOSOLVED = 1;
+constexpr uint8_t GENERIC_FLAG_SYMMETRICAL = 2;
+constexpr uint8_t GENERIC_FLAG_SYMMETRY_X = 4;
+constexpr uint8_t GENERIC_FLAG_SYMMETRY_Y = 8;
+constexpr uint8_t GENERIC_FLAG_PILLAR = 16;
+
+constexpr uint8_t SETTINGS_FLAG_NCN = 1;   // NEGATIONS_CANCEL_NEGATIONS
+constexpr uint8_t SETTINGS_FLAG_SZP = 2;   // SHAPELESS_ZERO_POLY
+constexpr uint8_t SETTINGS_FLAG_PP = 4;    // PRECISE_POLYOMINOS
+constexpr uint8_t SETTINGS_FLAG_FFE = 8;   // FLASH_FOR_ERRORS
+constexpr uint8_t SETTINGS_FLAG_FS = 16;   // FAT_STARTPOINTS
+constexpr uint8_t SETTINGS_FLAG_CM = 32;   // CUSTOM_MECHANICS
+
+// Settings of a new puzzle in engine/puzzle.js
+constexpr uint8_t SETTINGS_DEFAULT = SETTINGS_FLAG_NCN | SETTINGS_FLAG_PP | SETTINGS_FLAG_FFE;
+
+// Translation between the JSON strings and the compact constants.
+// Only deserialize/serialize/updateCell should need these.
+uint8_t cellTypeFromString(const std::string& type);
+const char* cellTypeToString(uint8_t type);
+uint8_t directionFromString(const std::string& dir);  // "left"/"right"/"top"/"bottom" -> PATH_*
+const char* directionToString(uint8_t dir);
+
 // Forward declarations
 class Cell;
 class Puzzle;
 
-// Represents a single cell in the puzzle grid
+// Represents a single cell in the puzzle grid.
+// Every field is a small integer, so a Cell is 16 bytes and a whole grid stays cache resident.
 class Cell {
 public:
-    int line = LINE_NONE;
-    int gap = GAP_NONE;
-    int dot = DOT_NONE;
-    bool start = false;
-    std::string end;
-    std::string type;
-    int color = 0;
-    int count = 0;
     uint32_t polyshape = 0;
-    std::string dir;
-    int nega = NEGA_NONE;  // Added negation type
+    uint8_t type = TYPE_NONE;
+    uint8_t color = 0;
+    uint8_t count = 0;
+    uint8_t line = LINE_NONE;
+    uint8_t gap = GAP_NONE;
+    uint8_t dot = DOT_NONE;
+    uint8_t end = PATH_NONE;  // Direction of the endpoint, PATH_NONE if this is not an end
+    uint8_t dir = PATH_NONE;  // Direction the path leaves this cell in
+    bool start = false;
+    uint8_t nega = NEGA_NONE;
+};
+
+// Partition of the grid into regions, as spans of flat cell indices.
+// Region r is cells[starts[r]] up to (but excluding) cells[starts[r + 1]].
+struct RegionMap {
+    std::vector<int> labels;  // Region of each cell, or -1 for cells covered by the line
+    std::vector<int> cells;   // Cell indices, grouped by region in flood fill order
+    std::vector<int> starts;
+    
+    int count() const { return static_cast<int>(starts.size()) - 1; }
+    const int* begin(int region) const { return cells.data() + starts[region]; }
+    const int* end(int region) const { return cells.data() + starts[region + 1]; }
 };
 
 // Main puzzle class that represents the entire puzzle grid
@@ -64,15 +119,50 @@ public:
     static std::unique_ptr<Puzzle> deserialize(const std::string& jsonStr);
     std::string serialize() const;
     
+    // The compact binary format of engine/serializer.js (serializer.cpp). The string form is the
+    // "_"-prefixed base64 text the web client stores; the pointer form reads raw, already decoded
+    // bytes. Cells are decoded straight into the grid, which has the same column-major order.
+    static std::unique_ptr<Puzzle> deserializeBinary(const std::string& data);
+    static std::unique_ptr<Puzzle> deserializeBinary(const uint8_t* data, size_t size);
+    std::string serializeBinary() const;
+    
     // Core puzzle functionality
     Cell* getCell(int x, int y);
+    
+    // Flat access. Cells are stored column by column, so index = x * actualHeight + y
+    // (the same layout as the solver's bitboards).
+    int index(int x, int y) const { return x * actualHeight + y; }
+    Cell& at(int index) { return grid[index]; }
+    const Cell& at(int index) const { return grid[index]; }
+    int size() const { return static_cast<int>(grid.size()); }
+    
+    // Index of the neighboring cell in direction PATH_LEFT..PATH_BOTTOM, or -1 if there is none.
+    // Pillar puzzles wrap around horizontally.
+    int neighbor(int index, int direction) const { return neighbors[index][direction - PATH_LEFT]; }
     void updateCell(int x, int y, const std::string& key, const json& value);
     void clearLines();
     std::vector<std::vector<std::pair<int, int>>> getRegions();
     std::vector<std::pair<int, int>> getRegion(int x, int y);
     
+    // Labels every cell with its region in a single pass over the grid. The returned map is
+    // owned by the puzzle and reused (without reallocating) by the next call.
+    const RegionMap& labelRegions();
+    
+    // Indices of the cells in the region containing (x, y), in the same order labelRegions()
+    // would list them. The returned vector is owned by the puzzle and reused by the next call.
+    const std::vector<int>& getRegionCells(int x, int y);
+    
     // Validation
     bool validate();
+    bool validateRegion(const std::vector<std::pair<int, int>>& region);
+    
+    // Cell-index form, used by validate() and the solver. Verdicts are memoized in the region
+    // cache, which assumes symbols are only changed through updateCell (which clears it).
+    bool validateRegion(const int* first, const int* last);
+    RegionCache& getRegionCache() { return regionCache; }
+    const RegionCache& getRegionCache() const { return regionCache; }
+    RegionCache& getPolyCache() { return polyFitter.getCache(); }
+    const RegionCache& getPolyCache() const { return polyFitter.getCache(); }
     bool placeShapesRecursively(const std::vector<std::pair<int, int>>& positions, 
                               std::vector<std::vector<int>>& grid,
                               const std::vector<uint32_t>& shapes,
@@ -83,8 +173,22 @@ public:
     int getWidth() const { return width; }
     int getHeight() const { return height; }
     bool isPillar() const { return pillar; }
-    int getActualWidth() const { return grid.size(); }
-    int getActualHeight() const { return grid[0].size(); }
+    int getActualWidth() const { return actualWidth; }
+    int getActualHeight() const { return actualHeight; }
+    const std::string& getName() const { return name; }
+    
+    // Symmetry puzzles are solved by two lines at once, the second one mirrored left-right (x),
+    // top-bottom (y), or both (rotational). See getSymmetricalPos in engine/puzzle.js.
+    bool hasSymmetry() const { return genericFlags & GENERIC_FLAG_SYMMETRICAL; }
+    bool hasSymmetryX() const { return genericFlags & GENERIC_FLAG_SYMMETRY_X; }
+    bool hasSymmetryY() const { return genericFlags & GENERIC_FLAG_SYMMETRY_Y; }
+    void setSymmetry(bool symmetrical, bool x, bool y);
+    
+    // Flat index of the lattice point mirroring index, and the direction mirroring dir
+    int symmetricalIndex(int index) const;
+    uint8_t symmetricalDir(uint8_t dir) const;
+    uint8_t getGenericFlags() const { return genericFlags; }
+    uint8_t getSettingsFlags() const { return settingsFlags; }
     
     // Grid wrapping
     int _mod(int val) const;
@@ -93,13 +197,43 @@ public:
     void printBoard() const;
     
 private:
-    std::vector<std::vector<Cell>> grid;
+    std::vector<Cell> grid;
+    std::vector<std::array<int, 4>> neighbors;
     int width;
     int height;
+    int actualWidth;
+    int actualHeight;
     bool pillar;
     
+    // Metadata carried by the binary format
+    std::string name;
+    uint8_t genericFlags = 0;   // GENERIC_FLAG_*, apart from the pillar flag
+    uint8_t settingsFlags = SETTINGS_DEFAULT;
+    std::vector<uint32_t> colors;  // RGBA of each color id (id - 1), as read from binary puzzles
+    
+    // Scratch space for region labelling and validation, kept to avoid reallocating
+    RegionMap regionMap;
+    std::vector<int> fillLabels;
+    std::vector<int> fillStack;
+    std::vector<int> regionCells;
+    std::vector<std::pair<int, int>> regionPositions;
+    std::vector<uint8_t> inRegion;
+    std::vector<int> squares;
+    std::vector<int> stars;
+    std::vector<int> triangles;  // Those touching the right number of lines
+    std::vector<int> polys;      // Polyominos and onimoylops
+    std::vector<uint32_t> polyShapes;
+    std::vector<uint32_t> ylopShapes;
+    PolyFitter polyFitter;
+    std::vector<uint64_t> regionMask;
+    RegionCache regionCache;
+    NegationResolver negationResolver;
+    
     // Helper methods
+    RegionVerdict _checkRegion(const std::vector<std::pair<int, int>>& region);
     bool _safeCell(int x, int y) const;
-    void _floodFill(int x, int y, std::vector<std::pair<int, int>>& region);
+    void _warnUnsupportedSettings() const;
+    void _buildNeighbors();
+    void _fillRegion(int seed, int label, std::vector<int>& labels, std::vector<int>& cells);
     void _floodFillOutside(int x, int y);
 }; 
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "region_cache.hpp"
+
+void RegionCache::setCapacity(size_t entries) {
+    capacity = entries;
+    clear();
+}
+
+const RegionVerdict* RegionCache::find(const std::vector<uint64_t>& mask) {
+    uint64_t hash = hashMask(mask);
+    auto [first, last] = slots.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        Entry& entry = entries[it->second];
+        if (entry.mask == mask) {
+            entry.referenced = true;
+            hits++;
+            return &entry.verdict;
+        }
+    }
+    misses++;
+    return nullptr;
+}
+
+void RegionCache::insert(const std::vector<uint64_t>& mask, RegionVerdict verdict) {
+    if (capacity == 0) {
+        return;
+    }
+
+    // New entries start unreferenced, so a region seen only once is the first to go
+    uint64_t hash = hashMask(mask);
+    if (entries.size() < capacity) {
+        entries.push_back({mask, hash, verdict, false});
+        slots.emplace(hash, entries.size() - 1);
+        return;
+    }
+
+    size_t slot = evict();
+    Entry& entry = entries[slot];
+    entry.mask = mask;
+    entry.hash = hash;
+    entry.verdict = verdict;
+    entry.referenced = false;
+    slots.emplace(hash, slot);
+}
+
+void RegionCache::clear() {
+    entries.clear();
+    slots.clear();
+    hand = 0;
+}
+
+// Sweeps the hand round, giving referenced entries a second chance, and frees the first
+// unreferenced one
+size_t RegionCache::evict() {
+    while (entries[hand].referenced) {
+        entries[hand].referenced = false;
+        hand = (hand + 1) % entries.size();
+    }
+    size_t slot = hand;
+    hand = (hand + 1) % entries.size();
+
+    auto [first, last] = slots.equal_range(entries[slot].hash);
+    for (auto it = first; it != last; ++it) {
+        if (it->second == slot) {
+            slots.erase(it);
+            break;
+        }
+    }
+    evictions++;
+    return slot;
+}
+
+uint64_t RegionCache::hashMask(const std::vector<uint64_t>& mask) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (auto word : mask) {
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// What Puzzle::validateRegion concluded about a region
+struct RegionVerdict {
+    bool valid = false;
+    int invalidElements = 0;  // Symbols and uncovered dots that broke a rule, before negations
+};
+
+// Verdicts keyed by the region's cell mask (one bit per lattice point, index = x * height + y).
+// A puzzle's symbols don't change while it is being solved, so the mask alone decides the
+// verdict, and many different paths carve out the same regions.
+// PolyFitter keeps its results in one too, keyed by the region mask and the shapes to fit.
+// Holds at most capacity entries. When full, the clock algorithm evicts an entry that has not
+// been hit since the hand last passed it.
+class RegionCache {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+    explicit RegionCache(size_t capacity = DEFAULT_CAPACITY) : capacity(capacity) {}
+
+    // Changing the capacity drops every entry. 0 disables the cache.
+    void setCapacity(size_t entries);
+    size_t getCapacity() const { return capacity; }
+    size_t size() const { return entries.size(); }
+
+    // Returns nullptr on a miss. The pointer is valid until the next insert or clear.
+    const RegionVerdict* find(const std::vector<uint64_t>& mask);
+    void insert(const std::vector<uint64_t>& mask, RegionVerdict verdict);
+    void clear();
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    void resetCounters() { hits = misses = evictions = 0; }
+
+private:
+    struct Entry {
+        std::vector<uint64_t> mask;
+        uint64_t hash;
+        RegionVerdict verdict;
+        bool referenced;
+    };
+
+    static uint64_t hashMask(const std::vector<uint64_t>& mask);
+    size_t evict();
+
+    size_t capacity;
+    std::vector<Entry> entries;
+    std::unordered_multimap<uint64_t, size_t> slots;  // Hash -> index into entries
+    size_t hand = 0;
+};
@@ -0,0 +1,355 @@
+#include "puzzle.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+// Reader and writer for the compact binary format of engine/serializer.js:
+//   int version (0), byte width, byte height, string name, byte genericFlags,
+//   one cell per lattice point (column by column), int pathLength [byte x, byte y, byte dir...],
+//   byte settingsFlags
+// Ints are 4 little-endian bytes, longs are two ints (low first), strings are an int length
+// followed by the characters, and colors are 4 RGBA bytes. The text form is "_" + base64.
+
+namespace {
+
+// Cell type codes of the binary format. Note that these are not the TYPE_* constants.
+constexpr uint8_t CELL_TYPE_NULL = 0;
+constexpr uint8_t CELL_TYPE_LINE = 1;
+constexpr uint8_t CELL_TYPE_SQUARE = 2;
+constexpr uint8_t CELL_TYPE_STAR = 3;
+constexpr uint8_t CELL_TYPE_NEGA = 4;
+constexpr uint8_t CELL_TYPE_TRIANGLE = 5;
+constexpr uint8_t CELL_TYPE_POLY = 6;
+constexpr uint8_t CELL_TYPE_YLOP = 7;
+
+// Start/end byte. The end bits (CELL_END_LEFT = 2 ... CELL_END_BOTTOM = 16) are 1 << PATH_*.
+constexpr uint8_t CELL_START = 1;
+
+constexpr uint32_t RGBA_NONE = 0x00000000;  // What the web client writes for a missing color
+constexpr uint32_t RGBA_WHITE = 0xFFFFFFFF;
+
+// Handed out to color ids that did not come from a binary puzzle (e.g. numeric JSON colors)
+const uint32_t DEFAULT_COLORS[] = {
+    0x000000FF, 0xFFFFFFFF, 0xFF0000FF, 0x0000FFFF, 0x008000FF, 0xFFFF00FF, 0xFFA500FF, 0x800080FF,
+    0xFF00FFFF, 0x00FFFFFF, 0x808080FF, 0xA52A2AFF, 0x00FF00FF, 0xFFC0CBFF, 0x000080FF, 0x808000FF,
+};
+
+const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int base64Value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+std::vector<uint8_t> base64Decode(const std::string& text, size_t first, size_t last) {
+    std::vector<uint8_t> bytes;
+    bytes.reserve((last - first) * 3 / 4);
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (size_t i = first; i < last; i++) {
+        if (text[i] == '=') break;
+        int value = base64Value(text[i]);
+        if (value < 0) throw std::runtime_error("Invalid base64 character in puzzle data");
+        buffer = (buffer << 6) | value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            bytes.push_back(static_cast<uint8_t>(buffer >> bits));
+        }
+    }
+    return bytes;
+}
+
+std::string base64Encode(const std::string& bytes) {
+    std::string text;
+    text.reserve((bytes.size() + 2) / 3 * 4);
+    for (size_t i = 0; i < bytes.size(); i += 3) {
+        uint32_t chunk = static_cast<uint8_t>(bytes[i]) << 16;
+        if (i + 1 < bytes.size()) chunk |= static_cast<uint8_t>(bytes[i + 1]) << 8;
+        if (i + 2 < bytes.size()) chunk |= static_cast<uint8_t>(bytes[i + 2]);
+        text += BASE64_ALPHABET[(chunk >> 18) & 63];
+        text += BASE64_ALPHABET[(chunk >> 12) & 63];
+        text += i + 1 < bytes.size() ? BASE64_ALPHABET[(chunk >> 6) & 63] : '=';
+        text += i + 2 < bytes.size() ? BASE64_ALPHABET[chunk & 63] : '=';
+    }
+    return text;
+}
+
+class Reader {
+public:
+    Reader(const uint8_t* d, size_t s) : data(d), size(s) {}
+
+    uint8_t readByte() {
+        if (index >= size) throw std::runtime_error("Cannot read past the end of the puzzle data");
+        return data[index++];
+    }
+
+    // engine/serializer.js writes little-endian ints but its readInt shifts by 4 bits per byte;
+    // the two agree for every value below 256, and this reads what writeInt actually wrote.
+    uint32_t readInt() {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 32; shift += 8) value |= uint32_t(readByte()) << shift;
+        return value;
+    }
+
+    uint64_t readLong() {
+        uint64_t low = readInt();
+        uint64_t high = readInt();
+        return low | (high << 32);
+    }
+
+    std::string readString() {
+        uint32_t length = readInt();
+        if (length > size - index) {
+            throw std::runtime_error("Cannot read a string of " + std::to_string(length) + " bytes from the puzzle data");
+        }
+        std::string value(reinterpret_cast<const char*>(data + index), length);
+        index += length;
+        return value;
+    }
+
+    uint32_t readRgba() {
+        uint32_t rgba = 0;
+        for (int i = 0; i < 4; i++) rgba = (rgba << 8) | readByte();
+        return rgba;
+    }
+
+    void finish() const {
+        if (index < size) {
+            throw std::runtime_error("Read not done, " + std::to_string(size - index) + " bytes remain");
+        }
+    }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t index = 0;
+};
+
+class Writer {
+public:
+    void writeByte(int b) {
+        if (b < 0 || b > 0xFF) throw std::runtime_error("Cannot write out-of-range byte " + std::to_string(b));
+        data += static_cast<char>(b);
+    }
+
+    void writeInt(uint32_t i) {
+        for (int shift = 0; shift < 32; shift += 8) writeByte((i >> shift) & 0xFF);
+    }
+
+    void writeLong(uint64_t l) {
+        writeInt(static_cast<uint32_t>(l));
+        writeInt(static_cast<uint32_t>(l >> 32));
+    }
+
+    void writeString(const std::string& s) {
+        writeInt(static_cast<uint32_t>(s.size()));
+        data += s;
+    }
+
+    void writeRgba(uint32_t rgba) {
+        for (int shift = 24; shift >= 0; shift -= 8) writeByte((rgba >> shift) & 0xFF);
+    }
+
+    std::string str() const { return "_" + base64Encode(data); }
+
+private:
+    std::string data;
+};
+
+// Color ids are indices into the puzzle's RGBA list (id - 1). Every symbol in the binary format
+// has a color, and the web client compares them as strings, so even RGBA_NONE gets an id of its
+// own; 0 (no color) is left for symbols that never had one, such as those read from JSON.
+uint8_t colorId(uint32_t rgba, std::vector<uint32_t>& colors) {
+    for (size_t i = 0; i < colors.size(); i++) {
+        if (colors[i] == rgba) return static_cast<uint8_t>(i + 1);
+    }
+    if (colors.size() >= 255) throw std::runtime_error("Too many distinct colors in puzzle");
+    colors.push_back(rgba);
+    return static_cast<uint8_t>(colors.size());
+}
+
+void readCell(Reader& s, Cell& cell, std::vector<uint32_t>& colors) {
+    uint8_t cellType = s.readByte();
+    // Null cells keep the default the grid was built with, like null cells in JSON
+    if (cellType == CELL_TYPE_NULL) return;
+
+    switch (cellType) {
+        case CELL_TYPE_LINE:
+            cell.type = TYPE_LINE;
+            cell.line = s.readByte();
+            cell.dot = s.readByte();
+            cell.gap = s.readByte();
+            break;
+        case CELL_TYPE_SQUARE:
+            cell.type = TYPE_SQUARE;
+            cell.color = colorId(s.readRgba(), colors);
+            break;
+        case CELL_TYPE_STAR:
+            cell.type = TYPE_STAR;
+            cell.color = colorId(s.readRgba(), colors);
+            break;
+        case CELL_TYPE_NEGA: {
+            cell.type = TYPE_NEGA;
+            uint32_t rgba = s.readRgba();
+            cell.color = colorId(rgba, colors);
+            cell.nega = (rgba >> 8) == (RGBA_WHITE >> 8) ? NEGA_WHITE : NEGA_BLACK;
+            break;
+        }
+        case CELL_TYPE_TRIANGLE:
+            cell.type = TYPE_TRIANGLE;
+            cell.color = colorId(s.readRgba(), colors);
+            cell.count = s.readByte();
+            break;
+        case CELL_TYPE_POLY:
+        case CELL_TYPE_YLOP:
+            cell.type = cellType == CELL_TYPE_POLY ? TYPE_POLY : TYPE_YLOP;
+            cell.color = colorId(s.readRgba(), colors);
+            cell.polyshape = static_cast<uint32_t>(s.readLong());
+            break;
+        default:
+            throw std::runtime_error("Unknown cell type in puzzle data: " + std::to_string(cellType));
+    }
+
+    uint8_t startEnd = s.readByte();
+    cell.start = (startEnd & CELL_START) != 0;
+    // The web client applies the bits in order, so the last direction set wins
+    cell.end = PATH_NONE;
+    for (uint8_t dir = PATH_LEFT; dir <= PATH_BOTTOM; dir++) {
+        if (startEnd & (1 << dir)) cell.end = dir;
+    }
+}
+
+void writeCell(Writer& s, const Cell& cell, const std::vector<uint32_t>& palette) {
+    if (cell.type == TYPE_NONE) {
+        s.writeByte(CELL_TYPE_NULL);
+        return;
+    }
+
+    uint32_t rgba = cell.color == 0 ? RGBA_NONE : palette[cell.color - 1];
+    switch (cell.type) {
+        case TYPE_LINE:
+            s.writeByte(CELL_TYPE_LINE);
+            s.writeByte(cell.line);
+            s.writeByte(cell.dot);
+            s.writeByte(cell.gap);
+            break;
+        case TYPE_SQUARE:
+            s.writeByte(CELL_TYPE_SQUARE);
+            s.writeRgba(rgba);
+            break;
+        case TYPE_STAR:
+            s.writeByte(CELL_TYPE_STAR);
+            s.writeRgba(rgba);
+            break;
+        case TYPE_NEGA:
+            s.writeByte(CELL_TYPE_NEGA);
+            // Uncolored negations read back as black, so only white needs spelling out
+            if (cell.color == 0 && cell.nega == NEGA_WHITE) rgba = RGBA_WHITE;
+            s.writeRgba(rgba);
+            break;
+        case TYPE_TRIANGLE:
+            s.writeByte(CELL_TYPE_TRIANGLE);
+            s.writeRgba(rgba);
+            s.writeByte(cell.count);
+            break;
+        case TYPE_POLY:
+        case TYPE_YLOP:
+            s.writeByte(cell.type == TYPE_POLY ? CELL_TYPE_POLY : CELL_TYPE_YLOP);
+            s.writeRgba(rgba);
+            s.writeLong(cell.polyshape);
+            break;
+        default:
+            throw std::runtime_error(std::string("The binary format has no cell type ") + cellTypeToString(cell.type));
+    }
+
+    uint8_t startEnd = cell.start ? CELL_START : 0;
+    if (cell.end >= PATH_LEFT && cell.end <= PATH_BOTTOM) startEnd |= 1 << cell.end;
+    s.writeByte(startEnd);
+}
+
+}
+
+std::unique_ptr<Puzzle> Puzzle::deserializeBinary(const std::string& data) {
+    size_t first = data.find_first_not_of(" \t\r\n");
+    size_t last = data.find_last_not_of(" \t\r\n");
+    if (first == std::string::npos || data[first] != '_') {
+        throw std::runtime_error("Cannot read data, improperly prefixed");
+    }
+    auto bytes = base64Decode(data, first + 1, last + 1);
+    return deserializeBinary(bytes.data(), bytes.size());
+}
+
+std::unique_ptr<Puzzle> Puzzle::deserializeBinary(const uint8_t* data, size_t size) {
+    Reader s(data, size);
+    uint32_t version = s.readInt();
+    if (version > 0) {
+        throw std::runtime_error("Cannot read data from unknown version: " + std::to_string(version));
+    }
+
+    int latticeWidth = s.readByte();
+    int latticeHeight = s.readByte();
+    std::string name = s.readString();
+    uint8_t flags = s.readByte();
+
+    if (latticeWidth / 2 <= 0 || latticeHeight / 2 <= 0) {
+        throw std::runtime_error("Invalid grid dimensions");
+    }
+    auto puzzle = std::make_unique<Puzzle>(latticeWidth / 2, latticeHeight / 2, (flags & GENERIC_FLAG_PILLAR) != 0);
+    if (puzzle->actualWidth != latticeWidth || puzzle->actualHeight != latticeHeight) {
+        throw std::runtime_error("Unsupported grid size " + std::to_string(latticeWidth) + "x" + std::to_string(latticeHeight));
+    }
+    puzzle->name = std::move(name);
+    puzzle->genericFlags = flags & ~GENERIC_FLAG_PILLAR;
+
+    // The format lists cells column by column, which is exactly the order of the grid buffer
+    for (auto& cell : puzzle->grid) {
+        readCell(s, cell, puzzle->colors);
+    }
+
+    // A stored solution path is skipped, as deserializePuzzle does
+    uint32_t pathLength = s.readInt();
+    if (pathLength > 0) {
+        s.readByte();
+        s.readByte();
+        for (uint32_t i = 0; i < pathLength; i++) s.readByte();
+    }
+
+    puzzle->settingsFlags = s.readByte();
+    s.finish();
+    puzzle->_warnUnsupportedSettings();
+    return puzzle;
+}
+
+std::string Puzzle::serializeBinary() const {
+    // Color ids that were not read from binary data get the first unused default color
+    std::vector<uint32_t> palette = colors;
+    uint8_t maxColor = 0;
+    for (const auto& cell : grid) maxColor = std::max(maxColor, cell.color);
+    auto addIfUnused = [&](uint32_t rgba) {
+        if (std::find(palette.begin(), palette.end(), rgba) == palette.end()) palette.push_back(rgba);
+    };
+    for (uint32_t rgba : DEFAULT_COLORS) {
+        if (palette.size() >= maxColor) break;
+        addIfUnused(rgba);
+    }
+    for (uint32_t rgb = 1; palette.size() < maxColor; rgb++) {
+        addIfUnused((rgb << 8) | 0xFF);
+    }
+
+    Writer s;
+    s.writeInt(0);  // Version
+    s.writeByte(actualWidth);
+    s.writeByte(actualHeight);
+    s.writeString(name);
+    s.writeByte(genericFlags | (pillar ? GENERIC_FLAG_PILLAR : 0));
+    for (const auto& cell : grid) {
+        writeCell(s, cell, palette);
+    }
+    s.writeInt(0);  // No path
+    s.writeByte(settingsFlags);
+    return s.str();
+}
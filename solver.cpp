@@ -1,148 +1,841 @@
 #include "solver.hpp"
-#include <iostream>
+#include "thread_pool.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <chrono>
 
 Solver::Solver(std::unique_ptr<Puzzle> p) : puzzle(std::move(p)) {
-    std::cout << "Created solver" << std::endl;
+    PUZZLE_LOG(LOG_DEBUG, "Created solver");
 }
 
-std::vector<Path> Solver::solve() {
+std::vector<PackedPath> Solver::solve() {
+    std::vector<std::pair<int, int>> startPoints;
+    int numEndpoints = 0;
+    if (prepareSolve(startPoints, numEndpoints)) {
+        runSolve(startPoints, numEndpoints);
+    }
+    return solutions;
+}
+
+size_t Solver::solve(const SolutionCallback& callback) {
+    std::vector<std::pair<int, int>> startPoints;
+    int numEndpoints = 0;
+    if (prepareSolve(startPoints, numEndpoints)) {
+        onSolution = &callback;
+        runSolve(startPoints, numEndpoints);
+        onSolution = nullptr;
+    }
+    return delivered;
+}
+
+void Solver::runSolve(const std::vector<std::pair<int, int>>& startPoints, int numEndpoints) {
+    if (numThreads == 1) {
+        solveSequential(startPoints, numEndpoints);
+    } else {
+        solveParallel(startPoints, numEndpoints);
+    }
+    
+    // Workers may overshoot maxSolutions by a few before they notice the limit
+    if (maxSolutions > 0 && solutions.size() > static_cast<size_t>(maxSolutions)) {
+        solutions.resize(maxSolutions);
+    }
+}
+
+// Resets the results and builds the search data. Returns false if there is nothing to search.
+bool Solver::prepareSolve(std::vector<std::pair<int, int>>& startPoints, int& numEndpoints) {
     solutions.clear();
+    solutionCount = 0;
+    cancelled = false;
+    delivered = 0;
+    stats = SolverStats();
+    stats.moveOrder = moveOrder;
+    stats.pruning = pruning;
     
     // Find all start points
-    auto startPoints = findStartPoints();
+    startPoints = findStartPoints();
     if (startPoints.empty()) {
-        std::cerr << "No start points found in puzzle" << std::endl;
-        return solutions;
+        PUZZLE_LOG(LOG_WARN, "No start points found in puzzle");
+        return false;
     }
     
     // Count total endpoints
-    int numEndpoints = countEndpoints();
+    numEndpoints = countEndpoints();
     if (numEndpoints == 0) {
-        std::cerr << "No endpoints found in puzzle" << std::endl;
-        return solutions;
+        PUZZLE_LOG(LOG_WARN, "No endpoints found in puzzle");
+        return false;
+    }
+    
+    puzzle->clearLines();
+    puzzle->getRegionCache().resetCounters();
+    puzzle->getPolyCache().resetCounters();
+    buildBoards();
+    return true;
+}
+
+void Solver::beginSolve() {
+    sliced = SearchState();
+    sliced.puzzle = puzzle.get();
+    nextStart = 0;
+    pretraversalNodes = 0;
+    slicedFinished = !prepareSolve(slicedStarts, slicedEndpoints);
+    if (slicedFinished) {
+        return;
+    }
+    
+    // Like countNodes in engine/solve.js, count the paths of up to NODE_DEPTH steps which only
+    // avoid collisions. The search counts the shallow nodes it visits against this total.
+    Bitboard visited(latticeWidth * latticeHeight);
+    for (const auto& [x, y] : slicedStarts) {
+        pretraversalNodes += countNodes(visited, x * latticeHeight + y, 0);
+    }
+    PUZZLE_LOG(LOG_DEBUG, "Pretraversal found " << pretraversalNodes << " nodes");
+}
+
+uint64_t Solver::countNodes(Bitboard& visited, int pos, int depth) const {
+    if (visited.test(pos) || blocked.test(pos)) return 0;
+    if (symmetric && (mirror[pos] == pos || blocked.test(mirror[pos]))) return 0;
+    if (depth >= NODE_DEPTH) return 0;
+    
+    visited.set(pos);
+    if (symmetric) visited.set(mirror[pos]);
+    uint64_t count = 1;
+    for (int direction = PATH_LEFT; direction <= PATH_BOTTOM; direction++) {
+        int next = puzzle->neighbor(pos, direction);
+        if (next >= 0) count += countNodes(visited, next, depth + 1);
     }
+    if (symmetric) visited.reset(mirror[pos]);
+    visited.reset(pos);
+    return count;
+}
+
+bool Solver::resumeSolve(uint64_t nodeBudget, std::chrono::microseconds timeBudget) {
+    auto deadline = std::chrono::steady_clock::now() + timeBudget;
+    uint64_t nodeLimit = nodeBudget > 0 ? sliced.nodes + nodeBudget : UINT64_MAX;
+    
+    while (!slicedFinished && sliced.nodes < nodeLimit) {
+        if (sliced.stack.empty()) {
+            if (nextStart == slicedStarts.size() || shouldStop()) {
+                slicedFinished = true;
+                break;
+            }
+            const auto& [x, y] = slicedStarts[nextStart++];
+            beginStart(sliced, x, y, slicedEndpoints);
+            continue;
+        }
+        
+        // Search in chunks, so that the clock is only read every so often
+        uint64_t chunk = nodeLimit - sliced.nodes;
+        if (timeBudget.count() > 0) chunk = std::min<uint64_t>(chunk, TIME_CHECK_NODES);
+        runSearch(sliced, chunk);
+        if (timeBudget.count() > 0 && std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+    }
+    
+    stats = SolverStats();
+    stats.moveOrder = moveOrder;
+    stats.pruning = pruning;
+    collectStats(sliced);
+    return slicedFinished;
+}
+
+double Solver::getProgress() const {
+    if (slicedFinished) return 1.0;
+    if (pretraversalNodes == 0) return 0.0;
+    return std::min(1.0, static_cast<double>(sliced.shallowNodes) / pretraversalNodes);
+}
+
+std::vector<PackedPath> Solver::takeSolutions() {
+    std::vector<PackedPath> taken = std::move(sliced.solutions);
+    sliced.solutions.clear();
+    return taken;
+}
+
+void Solver::solveSequential(const std::vector<std::pair<int, int>>& startPoints, int numEndpoints) {
+    SearchState state;
+    state.puzzle = puzzle.get();
     
     // Try solving from each start point
     for (const auto& [startX, startY] : startPoints) {
-        solveFromStart(startX, startY, numEndpoints);
-        if (maxSolutions > 0 && solutions.size() >= maxSolutions) {
+        solveFromStart(state, startX, startY, numEndpoints);
+        if (shouldStop()) {
             break;
         }
     }
     
-    return solutions;
+    solutions = std::move(state.solutions);
+    collectStats(state);
 }
 
-void Solver::solveFromStart(int startX, int startY, int numEndpoints) {
-    std::cout << "Starting solve from " << startX << "," << startY << std::endl;
-    Path path;
-    path.positions.push_back({startX, startY});
-    path.directions.push_back(PATH_NONE);
+// Runs the top of the search tree on this thread, cutting it off at splitDepth. Every path that
+// reaches that depth becomes a task, and the tasks are then solved by a work-stealing pool where
+// each worker owns a private copy of the puzzle. Solutions are stitched back together in task
+// order, so the result matches a sequential solve whenever maxSolutions is not reached.
+void Solver::solveParallel(const std::vector<std::pair<int, int>>& startPoints, int numEndpoints) {
+    std::vector<SearchTask> tasks;
+    SearchState splitter;
+    splitter.puzzle = puzzle.get();
+    splitter.frontier = &tasks;
+    splitter.splitDepth = std::max(splitDepth, 1);
     
-    puzzle->clearLines();
+    for (const auto& [startX, startY] : startPoints) {
+        solveFromStart(splitter, startX, startY, numEndpoints);
+        if (shouldStop()) {
+            break;
+        }
+    }
     
-    if (auto cell = puzzle->getCell(startX, startY)) {
-        std::cout << "Got start cell" << std::endl;
-        cell->line = LINE_BLACK;
-        solveLoop(startX, startY, numEndpoints, path);
-    } else {
-        std::cout << "Failed to get start cell!" << std::endl;
+    ThreadPool pool(numThreads);
+    std::vector<SearchState> workerStates(pool.size());
+    for (auto& state : workerStates) {
+        state.ownedPuzzle = std::make_unique<Puzzle>(*puzzle);
+        state.puzzle = state.ownedPuzzle.get();
+        state.puzzle->getRegionCache().resetCounters();
+        state.puzzle->getPolyCache().resetCounters();
     }
+    
+    std::vector<std::vector<PackedPath>> taskSolutions(tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++) {
+        pool.submit([this, &tasks, &workerStates, &taskSolutions, i] {
+            auto& state = workerStates[ThreadPool::workerIndex()];
+            solveTask(state, tasks[i]);
+            taskSolutions[i] = std::move(state.solutions);
+            state.solutions.clear();
+        });
+    }
+    pool.wait();
+    
+    for (size_t i = 0; i < tasks.size(); i++) {
+        for (auto& solution : tasks[i].precedingSolutions) solutions.push_back(std::move(solution));
+        for (auto& solution : taskSolutions[i]) solutions.push_back(std::move(solution));
+    }
+    for (auto& solution : splitter.solutions) solutions.push_back(std::move(solution));
+    
+    collectStats(splitter);
+    for (const auto& state : workerStates) collectStats(state);
+}
+
+void Solver::collectStats(const SearchState& state) {
+    stats.nodes += state.nodes;
+    stats.prunedMoves += state.prunedMoves;
+    stats.validations += state.validations;
+    stats.reachabilityChecks += state.reachabilityChecks;
+    stats.prunedBranches += state.prunedBranches;
+    stats.transpositionHits += state.transpositionHits;
+    stats.deadStates += state.deadStates;
+    
+    // Each state validates on its own puzzle, whose counters were reset when the solve began
+    const RegionCache& cache = state.puzzle->getRegionCache();
+    stats.regionCacheHits += cache.hits;
+    stats.regionCacheMisses += cache.misses;
+    const RegionCache& polyCache = state.puzzle->getPolyCache();
+    stats.polyCacheHits += polyCache.hits;
+    stats.polyCacheMisses += polyCache.misses;
+}
+
+void Solver::buildBoards() {
+    latticeWidth = puzzle->getActualWidth();
+    latticeHeight = puzzle->getActualHeight();
+    int size = latticeWidth * latticeHeight;
+    
+    blocked = Bitboard(size);
+    endpoints = Bitboard(size);
+    dots = Bitboard(size);
+    hasNegations = false;
+    bool hasConstraints = false;
+    
+    // The puzzle grid uses the same index layout as the bitboards
+    for (int pos = 0; pos < size; pos++) {
+        const Cell& cell = puzzle->at(pos);
+        bool isContent = (pos / latticeHeight) % 2 == 1 && (pos % latticeHeight) % 2 == 1;
+        
+        // Content cells are never part of the line, so they act as walls between edges
+        if (isContent || cell.gap > GAP_NONE) blocked.set(pos);
+        if (cell.end != PATH_NONE) endpoints.set(pos);
+        if (cell.dot > DOT_NONE) dots.set(pos);
+        if (cell.type == TYPE_NEGA) hasNegations = true;
+        if (cell.dot > DOT_NONE || (isContent && cell.type != TYPE_NONE)) hasConstraints = true;
+    }
+    
+    symmetric = puzzle->hasSymmetry();
+    mirror.clear();
+    if (symmetric) {
+        mirror.resize(size);
+        for (int pos = 0; pos < size; pos++) mirror[pos] = puzzle->symmetricalIndex(pos);
+    }
+    
+    // Cutting the grid in two only isolates a region when the sides don't wrap around.
+    // Without any symbols or dots, every closed-off region is trivially valid.
+    // In symmetry puzzles the mirrored line can still enter a region the path has cut off.
+    doPruning = !puzzle->isPillar() && hasConstraints && !symmetric;
+    
+    buildDistanceMaps();
+    buildZobristKeys();
+    transpositions.resize(symmetric ? 0 : transpositionBits);
 }
 
-void Solver::solveLoop(int x, int y, int numEndpoints, Path& path) {
-    if (maxSolutions > 0 && solutions.size() >= maxSolutions) {
+// Keys come from splitmix64 with a fixed seed, so hashes are the same from run to run
+void Solver::buildZobristKeys() {
+    int size = latticeWidth * latticeHeight;
+    uint64_t seed = 0x5851f42d4c957f2dull;
+    auto next = [&] {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    };
+    zobrist.resize(size);
+    zobristHead.resize(size);
+    for (int pos = 0; pos < size; pos++) {
+        zobrist[pos] = next();
+        zobristHead[pos] = next();
+    }
+}
+
+void Solver::buildDistanceMaps() {
+    int size = latticeWidth * latticeHeight;
+    
+    std::vector<int> sources;
+    endpoints.forEach([&](int pos) { sources.push_back(pos); });
+    endDistance.assign(size, NO_DISTANCE);
+    distanceMap(sources, endDistance.data());
+    
+    dotCells.clear();
+    dotDistance.clear();
+    dots.forEach([&](int pos) { dotCells.push_back(pos); });
+    if (moveOrder == ORDER_TOWARD_DOTS) {
+        dotDistance.assign(dotCells.size() * size, NO_DISTANCE);
+        for (size_t i = 0; i < dotCells.size(); i++) {
+            distanceMap({dotCells[i]}, dotDistance.data() + i * size);
+        }
+    }
+}
+
+// Breadth-first search from every source at once, over the lattice points the path could enter
+// if nothing had been visited yet. In symmetry puzzles that also needs the mirrored point open.
+void Solver::distanceMap(const std::vector<int>& sources, int* distance) const {
+    auto isOpen = [&](int pos) {
+        if (blocked.test(pos)) return false;
+        return !symmetric || (mirror[pos] != pos && !blocked.test(mirror[pos]));
+    };
+    
+    std::vector<int> queue;
+    for (int pos : sources) {
+        if (isOpen(pos) && distance[pos] == NO_DISTANCE) {
+            distance[pos] = 0;
+            queue.push_back(pos);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); head++) {
+        int pos = queue[head];
+        for (int direction = PATH_LEFT; direction <= PATH_BOTTOM; direction++) {
+            int next = puzzle->neighbor(pos, direction);
+            if (next >= 0 && distance[next] == NO_DISTANCE && isOpen(next)) {
+                distance[next] = distance[pos] + 1;
+                queue.push_back(next);
+            }
+        }
+    }
+}
+
+void Solver::solveFromStart(SearchState& state, int startX, int startY, int numEndpoints) {
+    if (beginStart(state, startX, startY, numEndpoints)) runSearch(state, 0);
+}
+
+// Sets up a path at the start point and enters it. Returns false if the search from here is
+// already over, otherwise runSearch carries it on.
+bool Solver::beginStart(SearchState& state, int startX, int startY, int numEndpoints) {
+    PUZZLE_LOG(LOG_DEBUG, "Starting solve from " << startX << "," << startY);
+    state.path.positions.clear();
+    state.path.directions.clear();
+    state.path.positions.push_back({startX, startY});
+    state.path.directions.push_back(PATH_NONE);
+    
+    int start = startX * latticeHeight + startY;
+    if (blocked.test(start)) {
+        return false;
+    }
+    if (symmetric && (mirror[start] == start || blocked.test(mirror[start]))) {
+        return false;
+    }
+    
+    prepareState(state);
+    state.visited.set(start);
+    if (symmetric) state.visited.set(mirror[start]);
+    return enterNode(state, start, numEndpoints, EdgeHistory());
+}
+
+void Solver::solveTask(SearchState& state, SearchTask& task) {
+    if (shouldStop()) {
         return;
     }
     
-    auto cell = puzzle->getCell(x, y);
-    if (!cell) {
+    prepareState(state);
+    state.path = task.path;
+    for (const auto& [x, y] : state.path.positions) {
+        int pos = x * latticeHeight + y;
+        state.visited.set(pos);
+        if (symmetric) state.visited.set(mirror[pos]);
+    }
+    
+    const auto& [x, y] = state.path.positions.back();
+    if (enterNode(state, x * latticeHeight + y, task.numEndpoints, task.history)) runSearch(state, 0);
+}
+
+// Sizes the state for this puzzle and clears it. The path never revisits a lattice point, so
+// reserving one frame per point means the stack and path never reallocate during the search.
+void Solver::prepareState(SearchState& state) {
+    int size = latticeWidth * latticeHeight;
+    if (state.visited.size() != size) state.visited = Bitboard(size);
+    state.visited.clear();
+    state.stack.clear();
+    state.stack.reserve(size);
+    state.path.positions.reserve(size);
+    state.path.directions.reserve(size);
+}
+
+bool Solver::shouldStop() const {
+    if (cancelled.load(std::memory_order_relaxed)) return true;
+    return maxSolutions > 0 && solutionCount.load(std::memory_order_relaxed) >= maxSolutions;
+}
+
+void Solver::addSolution(SearchState& state) {
+    int count = solutionCount.fetch_add(1, std::memory_order_relaxed);
+    if (maxSolutions > 0 && count >= maxSolutions) {
         return;
     }
     
-    // Don't check line status for the current cell since we just set it
-    if (cell->gap > GAP_NONE) {
+    if (onSolution) {
+        std::lock_guard<std::mutex> lock(callbackMutex);
+        // Another worker's callback may have asked to stop while this one was validating
+        if (cancelled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        PathView view{state.path.positions.data(), state.path.directions.data(), state.path.positions.size()};
+        delivered++;
+        if (!(*onSolution)(view)) cancelled = true;
         return;
     }
     
-    if (!cell->end.empty()) {
+    const auto& [startX, startY] = state.path.positions.front();
+    PackedPath packed(startX, startY, puzzle->isPillar() ? latticeWidth : 0);
+    for (size_t i = 1; i < state.path.directions.size(); i++) packed.push(state.path.directions[i]);
+    state.solutions.push_back(std::move(packed));
+}
+
+// Runs the checks on the point the path has just reached, and pushes a frame holding the moves
+// out of it. Returns false when this branch ends here, in which case nothing was pushed.
+bool Solver::enterNode(SearchState& state, int pos, int numEndpoints, EdgeHistory history) {
+    if (shouldStop()) {
+        return false;
+    }
+    
+    // Hand this whole subtree, including the checks on pos itself, to a worker
+    if (state.frontier && state.path.positions.size() >= state.splitDepth) {
+        SearchTask task;
+        task.path = state.path;
+        task.numEndpoints = numEndpoints;
+        task.history = history;
+        task.precedingSolutions = std::move(state.solutions);
+        state.solutions.clear();
+        state.frontier->push_back(std::move(task));
+        return false;
+    }
+    
+    // Skip the subtree if another path prefix already showed this state leads nowhere
+    SearchFrame area;
+    if (transpositions.enabled()) {
+        if (!openArea(state, pos, area)) {
+            state.prunedBranches++;
+            return false;
+        }
+        if (transpositions.contains(area.openHash ^ zobristHead[pos])) {
+            state.transpositionHits++;
+            return false;
+        }
+    }
+    uint64_t foundBefore = state.found;
+    state.nodes++;
+    if (static_cast<int>(state.path.positions.size()) <= NODE_DEPTH) state.shallowNodes++;
+    
+    if (endpoints.test(pos)) {
         // When we reach any endpoint, consider it a valid solution if the path is valid
-        if (validatePath(path)) {
-            solutions.push_back(path);
-            // Don't return here - continue searching for more solutions
-        }
-    }
-    
-    // Try moving in each direction
-    // We can move horizontally from even y coordinates
-    if (y % 2 == 0) {
-        // Try left
-        if (x > 0) {
-            if (auto nextCell = puzzle->getCell(x - 1, y)) {
-                if (nextCell->line == LINE_NONE && nextCell->gap <= GAP_NONE) {
-                    nextCell->line = LINE_BLACK;
-                    path.directions.push_back(PATH_LEFT);
-                    path.positions.push_back({x - 1, y});
-                    solveLoop(x - 1, y, numEndpoints, path);
-                    path.positions.pop_back();
-                    path.directions.pop_back();
-                    nextCell->line = LINE_NONE;
-                }
+        if (validatePath(state)) {
+            state.found++;
+            addSolution(state);
+        }
+        
+        // If there are no further endpoints, stop. Otherwise keep going -- we might reach another one.
+        if (--numEndpoints == 0) {
+            return false;
+        }
+    }
+    
+    // Once the path leaves the outer edge and then touches it again, it has split the grid in two.
+    // One step later we know which half we moved in to, so the other half is closed off for good
+    // and can be validated immediately. See the comment on doPruning in engine/solve.js.
+    if (doPruning) {
+        int x = pos / latticeHeight;
+        int y = pos % latticeHeight;
+        bool isEdge = x <= 0 || y <= 0 || x >= latticeWidth - 1 || y >= latticeHeight - 1;
+        if (history.hasLeftEdge && !history.prevPrevIsEdge && history.prevIsEdge && isEdge) {
+            int floodX = history.prev / latticeHeight + (history.prevPrev / latticeHeight - x);
+            int floodY = history.prev % latticeHeight + (history.prevPrev % latticeHeight - y);
+            if (!validateCutRegion(state, floodX, floodY, numEndpoints) || numEndpoints == 0) {
+                return false;
             }
         }
         
-        // Try right
-        if (x < puzzle->getActualWidth() - 1) {
-            if (auto nextCell = puzzle->getCell(x + 1, y)) {
-                if (nextCell->line == LINE_NONE && nextCell->gap <= GAP_NONE) {
-                    nextCell->line = LINE_BLACK;
-                    path.directions.push_back(PATH_RIGHT);
-                    path.positions.push_back({x + 1, y});
-                    solveLoop(x + 1, y, numEndpoints, path);
-                    path.positions.pop_back();
-                    path.directions.pop_back();
-                    nextCell->line = LINE_NONE;
-                }
+        history = {
+            history.hasLeftEdge || (!isEdge && history.prevIsEdge),
+            history.prev,
+            history.prevIsEdge,
+            pos,
+            isEdge,
+        };
+    }
+    
+    if ((pruning & PRUNE_REACHABILITY) && state.path.positions.size() % std::max(reachabilityInterval, 1) == 0) {
+        if (!canReachTargets(state, pos)) {
+            state.prunedBranches++;
+            return false;
+        }
+    }
+    
+    SearchFrame& frame = state.stack.emplace_back();
+    frame.numEndpoints = numEndpoints;
+    frame.history = history;
+    frame.openHash = area.openHash;
+    frame.closedCells = area.closedCells;
+    frame.openConnected = area.openConnected;
+    frame.foundBefore = foundBefore;
+    
+    // Collect the moves in each direction. The neighbor table wraps around pillars and has -1 off
+    // the grid. Content cells are blocked, so moves off the lattice lines are rejected by the same
+    // bit test as gaps and visited points. Heuristic orders are an insertion sort on moveKey,
+    // keeping the fixed order between ties.
+    int keys[4];
+    for (int direction = PATH_LEFT; direction <= PATH_BOTTOM; direction++) {
+        int next = state.puzzle->neighbor(pos, direction);
+        if (next < 0 || state.visited.test(next) || blocked.test(next)) continue;
+        
+        int key = moveOrder == ORDER_FIXED ? 0 : moveKey(state, next);
+        int i = frame.count++;
+        for (; i > 0 && keys[i - 1] > key; i--) {
+            frame.moves[i] = frame.moves[i - 1];
+            frame.directions[i] = frame.directions[i - 1];
+            keys[i] = keys[i - 1];
+        }
+        frame.moves[i] = next;
+        frame.directions[i] = direction;
+        keys[i] = key;
+    }
+    return true;
+}
+
+// Depth-first search driven by state.stack. Each frame is a point on the path with the moves
+// out of it that are left to try; the path and visited board always match the frames.
+// Returns false if it stopped because nodeBudget more nodes were visited (0 is unlimited), in
+// which case calling it again carries on where it left off. Returns true once the stack is empty.
+bool Solver::runSearch(SearchState& state, uint64_t nodeBudget) {
+    uint64_t nodeLimit = nodeBudget > 0 ? state.nodes + nodeBudget : UINT64_MAX;
+    while (!state.stack.empty()) {
+        if (shouldStop()) {
+            unwind(state);
+            break;
+        }
+        if (state.nodes >= nodeLimit) {
+            return false;
+        }
+        
+        SearchFrame& frame = state.stack.back();
+        if (frame.next == frame.count) {
+            popFrame(state, true);
+            continue;
+        }
+        
+        int next = frame.moves[frame.next];
+        int direction = frame.directions[frame.next];
+        frame.next++;
+        if (!canMove(state, next)) {
+            continue;
+        }
+        
+        // enterNode may push a frame, so copy out of this one first
+        int numEndpoints = frame.numEndpoints;
+        EdgeHistory history = frame.history;
+        makeMove(state, next, direction);
+        if (!enterNode(state, next, numEndpoints, history)) {
+            undoMove(state);
+        }
+    }
+    return true;
+}
+
+// The bottom frame is the start of the path (or of a task), which the caller set up.
+// finished is true when every move out of the frame has been searched. If none of them led to a
+// solution, the state is dead, unless the search was cut short by stopping or splitting.
+void Solver::popFrame(SearchState& state, bool finished) {
+    const SearchFrame& frame = state.stack.back();
+    if (finished && transpositions.enabled() && state.found == frame.foundBefore && !state.frontier && !shouldStop()) {
+        const auto& [x, y] = state.path.positions.back();
+        transpositions.insert(frame.openHash ^ zobristHead[x * latticeHeight + y]);
+        state.deadStates++;
+    }
+    
+    state.stack.pop_back();
+    if (!state.stack.empty()) undoMove(state);
+}
+
+void Solver::unwind(SearchState& state) {
+    while (!state.stack.empty()) popFrame(state, false);
+}
+
+// Floods the lattice points the path can still enter from pos. The path must be able to reach
+// another endpoint, and unless a negation could cancel it, every dot it has not covered yet.
+// In symmetry puzzles a dot is also covered when the mirrored line reaches it.
+bool Solver::canReachTargets(SearchState& state, int pos) {
+    state.reachabilityChecks++;
+    int size = latticeWidth * latticeHeight;
+    if (state.reached.size() != size) state.reached = Bitboard(size);
+    state.reached.clear();
+    state.queue.clear();
+    
+    auto isFree = [&](int p) {
+        if (state.visited.test(p) || blocked.test(p) || state.reached.test(p)) return false;
+        return !symmetric || (mirror[p] != p && !blocked.test(mirror[p]));
+    };
+    
+    bool anyEndpoint = false;
+    state.queue.push_back(pos);
+    for (size_t head = 0; head < state.queue.size(); head++) {
+        int current = state.queue[head];
+        for (int direction = PATH_LEFT; direction <= PATH_BOTTOM; direction++) {
+            int next = state.puzzle->neighbor(current, direction);
+            if (next >= 0 && isFree(next)) {
+                state.reached.set(next);
+                state.queue.push_back(next);
+                if (endpoints.test(next)) anyEndpoint = true;
             }
         }
     }
+    if (!anyEndpoint) {
+        return false;
+    }
     
-    // We can move vertically from even x coordinates
-    if (x % 2 == 0) {
-        // Try up
-        if (y > 0) {
-            if (auto nextCell = puzzle->getCell(x, y - 1)) {
-                if (nextCell->line == LINE_NONE && nextCell->gap <= GAP_NONE) {
-                    nextCell->line = LINE_BLACK;
-                    path.directions.push_back(PATH_TOP);
-                    path.positions.push_back({x, y - 1});
-                    solveLoop(x, y - 1, numEndpoints, path);
-                    path.positions.pop_back();
-                    path.directions.pop_back();
-                    nextCell->line = LINE_NONE;
+    if (!hasNegations) {
+        for (int dot : dotCells) {
+            if (state.visited.test(dot) || state.reached.test(dot)) continue;
+            if (symmetric && state.reached.test(mirror[dot])) continue;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whatever the rest of the search does happens inside the open area: the regions next to the head
+// of the path. Every other region is closed off for good, so two path prefixes with the same head
+// and open area have exactly the same completions. (Prefixes never cover exactly the same points:
+// a self-avoiding path is determined by the lattice points it covers, edges included.)
+// Fills in the open area fields of frame for the head pos. Returns false if a region that has
+// just been closed off is invalid, in which case no completion can be valid.
+// Symmetry puzzles are left out, as the mirrored line also moves through the closed regions.
+bool Solver::openArea(SearchState& state, int pos, SearchFrame& frame) {
+    // Usually the step to pos just takes it out of the parent's open area
+    const SearchFrame* parent = state.stack.empty() ? nullptr : &state.stack.back();
+    if (parent && parent->openConnected && !splitsOpenArea(state, pos)) {
+        frame.openHash = parent->openHash ^ zobrist[pos];
+        frame.closedCells = parent->closedCells;
+        frame.openConnected = true;
+        return true;
+    }
+    
+    int size = latticeWidth * latticeHeight;
+    if (state.reached.size() != size) state.reached = Bitboard(size);
+    state.reached.clear();
+    state.queue.clear();
+    
+    // Flood from each free neighbor in turn. Any after the first that is not reached yet lies in
+    // a separate region.
+    frame.openHash = 0;
+    frame.openConnected = true;
+    for (int direction = PATH_LEFT; direction <= PATH_BOTTOM; direction++) {
+        int seed = state.puzzle->neighbor(pos, direction);
+        if (seed < 0 || state.visited.test(seed) || state.reached.test(seed)) continue;
+        if (!state.queue.empty()) frame.openConnected = false;
+        
+        size_t head = state.queue.size();
+        state.reached.set(seed);
+        state.queue.push_back(seed);
+        for (; head < state.queue.size(); head++) {
+            int current = state.queue[head];
+            frame.openHash ^= zobrist[current];
+            for (int step = PATH_LEFT; step <= PATH_BOTTOM; step++) {
+                int next = state.puzzle->neighbor(current, step);
+                if (next >= 0 && !state.visited.test(next) && !state.reached.test(next)) {
+                    state.reached.set(next);
+                    state.queue.push_back(next);
                 }
             }
         }
+    }
+    frame.closedCells = size - state.visited.count() - static_cast<int>(state.queue.size());
+    
+    // The closed points only ever grow along a path, so the same count means the same points,
+    // which an ancestor has already checked
+    if (frame.closedCells == 0 || (parent && frame.closedCells == parent->closedCells)) {
+        return true;
+    }
+    
+    // As in Puzzle::validate, a point next to the line both vertically and horizontally is a gap
+    auto hasLine = [&](int p, int direction) {
+        int next = state.puzzle->neighbor(p, direction);
+        return next >= 0 && state.visited.test(next);
+    };
+    auto isGap = [&](int p) {
+        bool isContent = (p / latticeHeight) % 2 == 1 && (p % latticeHeight) % 2 == 1;
+        return !isContent && (hasLine(p, PATH_TOP) || hasLine(p, PATH_BOTTOM)) &&
+               (hasLine(p, PATH_LEFT) || hasLine(p, PATH_RIGHT));
+    };
+    
+    // Flood each closed region. Only regions with dots or symbols can be invalid, so the path is
+    // only drawn for validation once one of those turns up.
+    bool drawn = false;
+    bool valid = true;
+    for (int p = 0; p < size && valid; p++) {
+        if (state.visited.test(p) || state.reached.test(p)) continue;
         
-        // Try down
-        if (y < puzzle->getActualHeight() - 1) {
-            if (auto nextCell = puzzle->getCell(x, y + 1)) {
-                if (nextCell->line == LINE_NONE && nextCell->gap <= GAP_NONE) {
-                    nextCell->line = LINE_BLACK;
-                    path.directions.push_back(PATH_BOTTOM);
-                    path.positions.push_back({x, y + 1});
-                    solveLoop(x, y + 1, numEndpoints, path);
-                    path.positions.pop_back();
-                    path.directions.pop_back();
-                    nextCell->line = LINE_NONE;
+        bool constrained = false;
+        state.queue.clear();
+        state.reached.set(p);
+        state.queue.push_back(p);
+        for (size_t head = 0; head < state.queue.size(); head++) {
+            int current = state.queue[head];
+            if (isGap(current)) valid = false;
+            if (dots.test(current) || state.puzzle->at(current).type > TYPE_LINE) constrained = true;
+            for (int direction = PATH_LEFT; direction <= PATH_BOTTOM; direction++) {
+                int next = state.puzzle->neighbor(current, direction);
+                if (next >= 0 && !state.visited.test(next) && !state.reached.test(next)) {
+                    state.reached.set(next);
+                    state.queue.push_back(next);
                 }
             }
         }
+        if (!valid || !constrained) continue;
+        
+        if (!drawn) {
+            drawPath(state, LINE_BLACK);
+            drawn = true;
+        }
+        // With negations the number of invalid symbols counts, and that depends on the order the
+        // cells are checked in, so use the order validate() would
+        if (hasNegations) {
+            const auto& region = state.puzzle->getRegionCells(p / latticeHeight, p % latticeHeight);
+            valid = state.puzzle->validateRegion(region.data(), region.data() + region.size());
+        } else {
+            valid = state.puzzle->validateRegion(state.queue.data(), state.queue.data() + state.queue.size());
+        }
     }
+    if (drawn) drawPath(state, LINE_NONE);
+    return valid;
+}
+
+// True unless the free neighbors of pos are still connected to each other around it, which is
+// what keeps the open area in one piece once pos is taken out of it. Neighbors N and E are
+// connected if the diagonal point between them is free too.
+bool Solver::splitsOpenArea(const SearchState& state, int pos) const {
+    static constexpr int ring[4] = {PATH_TOP, PATH_RIGHT, PATH_BOTTOM, PATH_LEFT};
+    int around[4];
+    int free = 0;
+    for (int i = 0; i < 4; i++) {
+        around[i] = state.puzzle->neighbor(pos, ring[i]);
+        if (around[i] >= 0 && !state.visited.test(around[i])) free++;
+        else around[i] = -1;
+    }
+    
+    int links = 0;
+    for (int i = 0; i < 4; i++) {
+        int a = around[i];
+        int b = around[(i + 1) % 4];
+        if (a < 0 || b < 0) continue;
+        int diagonal = state.puzzle->neighbor(a, ring[(i + 1) % 4]);
+        if (diagonal >= 0 && !state.visited.test(diagonal)) links++;
+    }
+    int components = links == 4 ? 1 : free - links;
+    return components != 1;
+}
+
+// Lower keys are tried first
+int Solver::moveKey(const SearchState& state, int next) const {
+    if (moveOrder == ORDER_TOWARD_DOTS) {
+        int size = latticeWidth * latticeHeight;
+        int nearest = NO_DISTANCE;
+        bool anyLeft = false;
+        for (size_t i = 0; i < dotCells.size(); i++) {
+            if (state.visited.test(dotCells[i])) continue;
+            anyLeft = true;
+            nearest = std::min(nearest, dotDistance[i * size + next]);
+        }
+        if (anyLeft) return nearest;
+    }
+    return endDistance[next];
+}
+
+// True if the path would be stuck at next: it is not an endpoint, and every way out of it is
+// already visited or blocked
+bool Solver::isStranded(const SearchState& state, int next) const {
+    if (endpoints.test(next)) {
+        return false;
+    }
+    for (int direction = PATH_LEFT; direction <= PATH_BOTTOM; direction++) {
+        int after = state.puzzle->neighbor(next, direction);
+        if (after < 0 || state.visited.test(after) || blocked.test(after)) continue;
+        if (symmetric && (after == mirror[next] || mirror[after] == after || blocked.test(mirror[after]))) continue;
+        return false;
+    }
+    return true;
+}
+
+// Checks that were made on entering a node (visited, blocked) may be stale by the time a move
+// is tried, since the moves before it have been explored in between. They are cheap to repeat.
+bool Solver::canMove(SearchState& state, int next) {
+    if (state.visited.test(next) || blocked.test(next)) {
+        return false;
+    }
+    
+    // The mirrored line moves too. Because mirroring is its own inverse, it can only run into the
+    // path (or itself) where the path would, except on the axis, where the two lines would meet.
+    if (symmetric && (mirror[next] == next || blocked.test(mirror[next]))) {
+        return false;
+    }
+    
+    if (((pruning & PRUNE_UNREACHABLE) && endDistance[next] == NO_DISTANCE) ||
+        ((pruning & PRUNE_STRANDED) && isStranded(state, next))) {
+        state.prunedMoves++;
+        return false;
+    }
+    return true;
+}
+
+void Solver::makeMove(SearchState& state, int next, int direction) {
+    state.visited.set(next);
+    if (symmetric) state.visited.set(mirror[next]);
+    state.path.directions.push_back(direction);
+    state.path.positions.push_back({next / latticeHeight, next % latticeHeight});
+}
+
+// Takes back the last step of the path
+void Solver::undoMove(SearchState& state) {
+    const auto& [x, y] = state.path.positions.back();
+    int pos = x * latticeHeight + y;
+    if (symmetric) state.visited.reset(mirror[pos]);
+    state.visited.reset(pos);
+    state.path.positions.pop_back();
+    state.path.directions.pop_back();
 }
 
 std::vector<std::pair<int, int>> Solver::findStartPoints() {
-    std::cout << "Finding start points..." << std::endl;
+    PUZZLE_LOG(LOG_DEBUG, "Finding start points...");
     std::vector<std::pair<int, int>> startPoints;
     
     // Use actual grid dimensions
@@ -150,7 +843,7 @@ std::vector<std::pair<int, int>> Solver::findStartPoints() {
         for (int y = 0; y < puzzle->getActualHeight(); y++) {
             if (auto cell = puzzle->getCell(x, y)) {
                 if (cell->start) {
-                    std::cout << "Found start at " << x << "," << y << std::endl;
+                    PUZZLE_LOG(LOG_TRACE, "Found start at " << x << "," << y);
                     startPoints.push_back({x, y});
                 }
             }
@@ -162,40 +855,71 @@ std::vector<std::pair<int, int>> Solver::findStartPoints() {
 
 int Solver::countEndpoints() {
     int numEndpoints = 0;
-    std::cout << "Counting endpoints in puzzle..." << std::endl;
+    PUZZLE_LOG(LOG_DEBUG, "Counting endpoints in puzzle...");
     
     // Get actual grid dimensions using the new getter methods
     int actualWidth = puzzle->getActualWidth();
     int actualHeight = puzzle->getActualHeight();
     
-    std::cout << "Searching in grid of size " << actualWidth << "x" << actualHeight << std::endl;
+    PUZZLE_LOG(LOG_DEBUG, "Searching in grid of size " << actualWidth << "x" << actualHeight);
     
     for (int x = 0; x < actualWidth; x++) {
         for (int y = 0; y < actualHeight; y++) {
             Cell* cell = puzzle->getCell(x, y);
-            if (cell && !cell->end.empty()) {
-                std::cout << "Found endpoint at " << x << "," << y << " with direction: " << cell->end << std::endl;
+            if (cell && cell->end != PATH_NONE) {
+                PUZZLE_LOG(LOG_TRACE, "Found endpoint at " << x << "," << y << " with direction: " << directionToString(cell->end));
                 numEndpoints++;
             }
         }
     }
-    std::cout << "Found " << numEndpoints << " endpoints" << std::endl;
+    PUZZLE_LOG(LOG_DEBUG, "Found " << numEndpoints << " endpoints");
     return numEndpoints;
 }
 
-bool Solver::validatePath(const Path& path) {
-    // Create a copy of the puzzle to test the path
-    auto testPuzzle = std::make_unique<Puzzle>(*puzzle);
-    testPuzzle->clearLines();
+bool Solver::validatePath(SearchState& state) {
+    state.validations++;
     
-    // Draw the path
-    for (size_t i = 0; i < path.positions.size(); i++) {
-        auto [x, y] = path.positions[i];
-        if (auto cell = testPuzzle->getCell(x, y)) {
-            cell->line = LINE_BLACK;
-        }
+    // Every dot must be covered, unless a negation might cancel the uncovered one
+    if (!hasNegations && !dots.isSubsetOf(state.visited)) {
+        return false;
     }
     
-    // Validate the resulting puzzle state
-    return testPuzzle->validate();
-}
\ No newline at end of file
+    // Draw the path onto the live puzzle, validate in place, then erase it again.
+    // The puzzle is kept free of lines between endpoints, so only the path cells need touching.
+    drawPath(state, LINE_BLACK);
+    bool valid = state.puzzle->validate();
+    drawPath(state, LINE_NONE);
+    
+    return valid;
+}
+
+// Validates the region containing (floodX, floodY), which the path has just closed off.
+// Endpoints inside it can no longer be reached, so they are subtracted from numEndpoints.
+bool Solver::validateCutRegion(SearchState& state, int floodX, int floodY, int& numEndpoints) {
+    drawPath(state, LINE_BLACK);
+    const auto& region = state.puzzle->getRegionCells(floodX, floodY);
+    bool valid = region.empty() || state.puzzle->validateRegion(region.data(), region.data() + region.size());
+    drawPath(state, LINE_NONE);
+    
+    if (!valid) {
+        return false;
+    }
+    
+    for (int pos : region) {
+        if (endpoints.test(pos)) numEndpoints--;
+    }
+    return true;
+}
+
+// Symmetry puzzles draw the path in blue and its mirror in yellow, so colored dots can be checked
+void Solver::drawPath(SearchState& state, int line) {
+    for (const auto& [x, y] : state.path.positions) {
+        int pos = x * latticeHeight + y;
+        if (symmetric) {
+            state.puzzle->at(pos).line = line == LINE_NONE ? LINE_NONE : LINE_BLUE;
+            state.puzzle->at(mirror[pos]).line = line == LINE_NONE ? LINE_NONE : LINE_YELLOW;
+        } else {
+            state.puzzle->at(pos).line = line;
+        }
+    }
+}
@@ -1,34 +1,286 @@
 #pragma once
 
 #include "puzzle.hpp"
+#include "bitboard.hpp"
+#include "packed_path.hpp"
+#include "transposition_table.hpp"
 #include <vector>
+#include <algorithm>
 #include <memory>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <mutex>
 
-// Represents a path through the puzzle
+// Order in which the solver tries the moves out of each lattice point
+constexpr int ORDER_FIXED = 0;        // Left, right, top, bottom, as engine/solve.js does
+constexpr int ORDER_TOWARD_END = 1;   // Closest to an endpoint first
+constexpr int ORDER_TOWARD_DOTS = 2;  // Closest to a dot the path has not covered yet, then toward an end
+
+// Names of the move orders, indexed by ORDER_*
+inline constexpr const char* MOVE_ORDER_NAMES[] = {"fixed", "end", "dots"};
+
+// Moves the solver may skip without losing solutions (combine with |)
+constexpr int PRUNE_NONE = 0;
+constexpr int PRUNE_UNREACHABLE = 1;  // Lattice points with no route to any endpoint, even on an empty grid
+constexpr int PRUNE_STRANDED = 2;     // Dead ends that are not endpoints themselves
+constexpr int PRUNE_REACHABILITY = 4; // Paths which can no longer reach an endpoint or an uncovered dot
+constexpr int PRUNE_ALL = PRUNE_UNREACHABLE | PRUNE_STRANDED | PRUNE_REACHABILITY;
+
+// Represents a path through the puzzle. The search extends one of these as it goes; solutions
+// are kept as PackedPaths.
 struct Path {
     std::vector<std::pair<int, int>> positions;
     std::vector<int> directions;
 };
 
+// A solution as the search finds it. It borrows the search's own path, so it is only valid
+// until the callback it was passed to returns; use toPath() to keep it.
+struct PathView {
+    const std::pair<int, int>* positions;
+    const int* directions;  // PATH_* taken to reach each position, PATH_NONE for the start
+    size_t size;
+    
+    Path toPath() const {
+        return {{positions, positions + size}, {directions, directions + size}};
+    }
+};
+
+// Receives each solution as it is found. Return false to stop the search.
+using SolutionCallback = std::function<bool(const PathView&)>;
+
+// Tracks the last two positions of the path and whether it has ever left the outer edge.
+// Used to detect when the path cuts off a region (see earlyExitData in engine/solve.js).
+struct EdgeHistory {
+    bool hasLeftEdge = false;
+    int prevPrev = -1;
+    bool prevPrevIsEdge = false;
+    int prev = -1;
+    bool prevIsEdge = false;
+};
+
+// A subtree of the search, rooted at the end of a path prefix
+struct SearchTask {
+    Path path;
+    int numEndpoints = 0;
+    EdgeHistory history;
+    std::vector<PackedPath> precedingSolutions;  // Found while splitting, before this task was emitted
+};
+
+// A point on the path being searched, with the moves out of it still to be tried
+struct SearchFrame {
+    int numEndpoints = 0;  // Endpoints still reachable from here
+    EdgeHistory history;
+    int moves[4];          // Lattice points to move to, in the order to try them
+    int directions[4];
+    uint8_t count = 0;
+    uint8_t next = 0;      // Index of the next move to try
+    
+    // Transposition data, see Solver::openArea
+    uint64_t openHash = 0;     // Zobrist hash of the open area
+    int closedCells = -1;      // Lattice points closed off from the head, -1 if not known
+    bool openConnected = false;  // The open area is a single region
+    uint64_t foundBefore = 0;  // SearchState::found on entering this point
+};
+
+// Mutable search state. Every thread owns one, so nothing here is shared.
+struct SearchState {
+    Puzzle* puzzle = nullptr;               // Grid that paths are drawn on for validation
+    std::unique_ptr<Puzzle> ownedPuzzle;    // Set when puzzle is a private copy
+    Bitboard visited;                       // Lattice points and edges covered by the current path
+    Path path;
+    std::vector<SearchFrame> stack;         // One frame per point of path, see Solver::runSearch
+    uint64_t found = 0;                     // Valid solutions found, including any not kept
+    std::vector<PackedPath> solutions;
+    
+    // Counters for SolverStats, summed over every state once the solve is done
+    uint64_t nodes = 0;
+    uint64_t shallowNodes = 0;  // Nodes within Solver::NODE_DEPTH steps of the start, for progress
+    uint64_t prunedMoves = 0;
+    uint64_t validations = 0;
+    uint64_t reachabilityChecks = 0;
+    uint64_t prunedBranches = 0;
+    uint64_t transpositionHits = 0;
+    uint64_t deadStates = 0;
+    
+    // Scratch space for the reachability check
+    Bitboard reached;
+    std::vector<int> queue;
+    
+    // While splitting the search into tasks, paths which reach splitDepth are emitted here
+    std::vector<SearchTask>* frontier = nullptr;
+    size_t splitDepth = 0;
+};
+
+// Search effort of the last Solver::solve()
+struct SolverStats {
+    int moveOrder = ORDER_FIXED;
+    int pruning = PRUNE_NONE;
+    uint64_t nodes = 0;        // Lattice points the path was extended to
+    uint64_t prunedMoves = 0;  // Moves skipped by the pruning rules
+    uint64_t validations = 0;  // Complete paths that were validated
+    uint64_t reachabilityChecks = 0;
+    uint64_t prunedBranches = 0;  // Paths abandoned by the reachability check
+    uint64_t regionCacheHits = 0;
+    uint64_t regionCacheMisses = 0;
+    uint64_t polyCacheHits = 0;    // Polyomino tilings answered by PolyFitter's cache
+    uint64_t polyCacheMisses = 0;
+    uint64_t transpositionHits = 0;  // Points skipped because the table knew them to be dead
+    uint64_t deadStates = 0;         // Points recorded in the table
+};
+
 class Solver {
 public:
     explicit Solver(std::unique_ptr<Puzzle> p);
     
     // Main solving methods
-    std::vector<Path> solve();
+    std::vector<PackedPath> solve();
+    
+    // Streams solutions to onSolution instead of keeping them, so memory use does not grow with
+    // the number of solutions. With several threads the calls are serialized but come in no
+    // particular order. Returns the number of solutions passed to onSolution.
+    size_t solve(const SolutionCallback& onSolution);
     
     // Set maximum number of solutions to find (0 for unlimited)
     void setMaxSolutions(int max) { maxSolutions = max; }
     
+    // Number of worker threads (1 solves on the calling thread, 0 uses every core)
+    void setThreads(int threads) { numThreads = threads; }
+    
+    // Path length at which the search is split into independent tasks for the workers
+    void setSplitDepth(int depth) { splitDepth = depth; }
+    
+    // Move ordering heuristic (ORDER_*) and pruning rules (PRUNE_* flags) for the next solve.
+    // Neither changes which solutions are found, but the ordering changes the order they are
+    // found in, and so which ones are kept when maxSolutions is reached.
+    void setMoveOrder(int order) { moveOrder = order; }
+    void setPruning(int flags) { pruning = flags; }
+    
+    // With PRUNE_REACHABILITY, flood the free lattice from the head of the path every this many
+    // steps. 1 checks every step, which cuts branches earliest but costs a flood fill per node.
+    void setReachabilityInterval(int steps) { reachabilityInterval = steps; }
+    
+    // Remember up to 2^bits search states (the head of the path and the area it can still reach)
+    // whose subtree held no solution, and skip them when another path prefix reaches them. Also
+    // abandons paths as soon as a region they close off is invalid. 0 disables; symmetry puzzles
+    // never use the table. States are matched by a 64-bit hash, so a collision could in
+    // principle hide a solution. bits is clamped to 0..TranspositionTable::MAX_BITS.
+    void setTranspositionBits(int bits) { transpositionBits = std::clamp(bits, 0, TranspositionTable::MAX_BITS); }
+    
+    const SolverStats& getStats() const { return stats; }
+    
+    // Time-sliced solving, like taskLoop in engine/solve.js. beginSolve() prepares a search on the
+    // calling thread, and each resumeSolve() carries it on until nodeBudget more nodes have been
+    // visited or timeBudget has passed (0 for no limit on either). It returns true once the search
+    // is finished, whether exhausted, cancelled or stopped at maxSolutions.
+    void beginSolve();
+    bool resumeSolve(uint64_t nodeBudget, std::chrono::microseconds timeBudget = std::chrono::microseconds::zero());
+    
+    // Estimated fraction of a time-sliced search done so far, from 0 to 1
+    double getProgress() const;
+    
+    // Solutions a time-sliced search has found since the last call
+    std::vector<PackedPath> takeSolutions();
+    
+    // Stop an in-progress solve as soon as possible. Safe to call from any thread.
+    void cancel() { cancelled = true; }
+    
 private:
     std::unique_ptr<Puzzle> puzzle;
-    std::vector<Path> solutions;
+    std::vector<PackedPath> solutions;
     int maxSolutions = 0;
+    int numThreads = 1;
+    int splitDepth = 12;
+    int moveOrder = ORDER_FIXED;
+    int pruning = PRUNE_NONE;
+    int reachabilityInterval = 4;
+    int transpositionBits = 0;
+    SolverStats stats;
+    
+    // Progress is estimated from the nodes within NODE_DEPTH steps of a start, as in engine/solve.js
+    static constexpr int NODE_DEPTH = 9;
+    
+    // Time-sliced searches read the clock after this many nodes
+    static constexpr uint64_t TIME_CHECK_NODES = 1024;
+    
+    // State of the time-sliced search, kept between calls to resumeSolve
+    SearchState sliced;
+    std::vector<std::pair<int, int>> slicedStarts;
+    size_t nextStart = 0;
+    int slicedEndpoints = 0;
+    bool slicedFinished = true;
+    uint64_t pretraversalNodes = 0;
+    
+    // Shared between workers: every solution found bumps solutionCount, and the search
+    // stops once it reaches maxSolutions or cancel() is called.
+    std::atomic<int> solutionCount{0};
+    std::atomic<bool> cancelled{false};
+    
+    // Set during a streaming solve. The mutex serializes the calls from different workers.
+    const SolutionCallback* onSolution = nullptr;
+    std::mutex callbackMutex;
+    size_t delivered = 0;
+    
+    // Immutable search data, as bitboards over the lattice (index = x * latticeHeight + y)
+    int latticeWidth = 0;
+    int latticeHeight = 0;
+    Bitboard blocked;    // Gaps and content cells, which the line can never enter
+    Bitboard endpoints;  // Lattice points with an end
+    Bitboard dots;       // Lattice points and edges with a dot
+    bool hasNegations = false;
+    bool doPruning = false;
+    
+    // Symmetry puzzles move a mirrored line in lockstep with the path. mirror[pos] is the lattice
+    // point mirroring pos; the mirrored points are marked in the same visited board.
+    bool symmetric = false;
+    std::vector<int> mirror;
+    
+    // Breadth-first distances over the open lattice, NO_DISTANCE where there is no route.
+    // endDistance is to the nearest endpoint; dotDistance holds one map per dot, in dotCells order,
+    // and is only built for ORDER_TOWARD_DOTS.
+    static constexpr int NO_DISTANCE = INT32_MAX;
+    std::vector<int> endDistance;
+    std::vector<int> dotCells;
+    std::vector<int> dotDistance;
+    
+    // Random keys for each lattice point being on the path, and being its head
+    std::vector<uint64_t> zobrist;
+    std::vector<uint64_t> zobristHead;
+    TranspositionTable transpositions;
     
     // Helper methods
-    void solveFromStart(int startX, int startY, int numEndpoints);
-    void solveLoop(int x, int y, int numEndpoints, Path& path);
-    bool validatePath(const Path& path);
+    void runSolve(const std::vector<std::pair<int, int>>& startPoints, int numEndpoints);
+    bool prepareSolve(std::vector<std::pair<int, int>>& startPoints, int& numEndpoints);
+    uint64_t countNodes(Bitboard& visited, int pos, int depth) const;
+    void buildBoards();
+    void buildDistanceMaps();
+    void buildZobristKeys();
+    void distanceMap(const std::vector<int>& sources, int* distance) const;
+    int moveKey(const SearchState& state, int next) const;
+    bool isStranded(const SearchState& state, int next) const;
+    bool canReachTargets(SearchState& state, int pos);
+    bool splitsOpenArea(const SearchState& state, int pos) const;
+    bool openArea(SearchState& state, int pos, SearchFrame& frame);
+    void collectStats(const SearchState& state);
+    void solveSequential(const std::vector<std::pair<int, int>>& startPoints, int numEndpoints);
+    void solveParallel(const std::vector<std::pair<int, int>>& startPoints, int numEndpoints);
+    void solveFromStart(SearchState& state, int startX, int startY, int numEndpoints);
+    bool beginStart(SearchState& state, int startX, int startY, int numEndpoints);
+    void solveTask(SearchState& state, SearchTask& task);
+    void prepareState(SearchState& state);
+    bool enterNode(SearchState& state, int pos, int numEndpoints, EdgeHistory history);
+    bool runSearch(SearchState& state, uint64_t nodeBudget);
+    void popFrame(SearchState& state, bool finished);
+    void unwind(SearchState& state);
+    bool canMove(SearchState& state, int next);
+    void makeMove(SearchState& state, int next, int direction);
+    void undoMove(SearchState& state);
+    bool shouldStop() const;
+    void addSolution(SearchState& state);
+    bool validatePath(SearchState& state);
+    bool validateCutRegion(SearchState& state, int floodX, int floodY, int& numEndpoints);
+    void drawPath(SearchState& state, int line);
     std::vector<std::pair<int, int>> findStartPoints();
     int countEndpoints();
-}; 
\ No newline at end of file
+};
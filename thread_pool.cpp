@@ -0,0 +1,117 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace {
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local int currentWorker = -1;
+}
+
+ThreadPool::ThreadPool(int numThreads) {
+    if (numThreads <= 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    for (int i = 0; i < numThreads; i++) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (int i = 0; i < numThreads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::workerIndex() {
+    return currentWorker;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t index;
+    if (currentPool == this) {
+        index = currentWorker;
+    } else {
+        index = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    }
+    
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+        queued.fetch_add(1);
+    }
+    {
+        // Taking the lock orders this notify after a sleeping worker's last check for work
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeup.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    idle.wait(lock, [this] { return pending.load() == 0; });
+}
+
+bool ThreadPool::popTask(int index, std::function<void()>& task) {
+    // Own queue first, newest task
+    {
+        auto& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    
+    // Then steal the oldest task from another worker
+    for (size_t i = 1; i < queues.size(); i++) {
+        auto& victim = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(int index) {
+    currentPool = this;
+    currentWorker = index;
+    
+    std::function<void()> task;
+    while (true) {
+        if (popTask(index, task)) {
+            task();
+            task = nullptr;
+            if (pending.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                idle.notify_all();
+            }
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if (stopping) return;
+        // A task may have been queued after popTask looked at its deque,
+        // so only sleep while nothing is queued; otherwise go around and try again.
+        if (queued.load() == 0) {
+            wakeup.wait(lock, [this] { return stopping || queued.load() > 0; });
+        } else {
+            lock.unlock();
+            std::this_thread::yield();
+        }
+    }
+}
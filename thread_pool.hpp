@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+// Each worker owns a deque of tasks: it pops its own work from the back (depth-first, cache-warm)
+// and, when it runs dry, steals from the front of the other workers' deques (the oldest, and
+// usually largest, pieces of work).
+class ThreadPool {
+public:
+    // numThreads <= 0 uses std::thread::hardware_concurrency()
+    explicit ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task. Tasks submitted from a worker go to that worker's own deque,
+    // all others are distributed round-robin.
+    void submit(std::function<void()> task);
+
+    // Block until every submitted task (including ones submitted by tasks) has finished
+    void wait();
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    // Index of the calling worker in [0, size()), or -1 when called from outside the pool
+    static int workerIndex();
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};
+    std::atomic<int> pending{0};  // Submitted but not yet finished
+    std::atomic<int> queued{0};   // Sitting in a deque, waiting for a worker
+    bool stopping = false;
+
+    // Guards sleeping: workers wait on wakeup when there is nothing to steal,
+    // and wait() waits on idle until pending drops to zero.
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    std::condition_variable idle;
+
+    void workerLoop(int index);
+    bool popTask(int index, std::function<void()>& task);
+};
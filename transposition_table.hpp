@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Fixed-size, lock-free set of 64-bit hashes, shared by every search thread.
+// Each hash has one slot (hash modulo the size); a newer hash simply overwrites an older one in
+// the same slot, so lookups can miss but never block. 0 marks an empty slot.
+class TranspositionTable {
+public:
+    // 2^30 slots take 8 GiB, which is already more than a solve can use
+    static constexpr int MAX_BITS = 30;
+
+    TranspositionTable() = default;
+
+    // Sizes the table to 2^bits slots and empties it. 0 bits disables the table; bits outside
+    // 0..MAX_BITS are clamped to it.
+    void resize(int bits) {
+        bits = std::clamp(bits, 0, MAX_BITS);
+        mask = bits > 0 ? (size_t(1) << bits) - 1 : 0;
+        slots.reset(bits > 0 ? new std::atomic<uint64_t>[mask + 1] : nullptr);
+        clear();
+    }
+
+    void clear() {
+        if (!slots) return;
+        for (size_t i = 0; i <= mask; i++) slots[i].store(0, std::memory_order_relaxed);
+    }
+
+    bool enabled() const { return slots != nullptr; }
+
+    bool contains(uint64_t hash) const {
+        hash = hash ? hash : 1;
+        return slots[hash & mask].load(std::memory_order_relaxed) == hash;
+    }
+
+    void insert(uint64_t hash) {
+        hash = hash ? hash : 1;
+        slots[hash & mask].store(hash, std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    size_t mask = 0;
+};